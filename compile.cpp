@@ -0,0 +1,81 @@
+#include "libgrt_util.h"
+#include "cmdline.h"
+#include "compiled.h"
+
+/* quote a path for the shell */
+static string quote(const string &s) {
+  string q = "'";
+  for (char c : s)
+    q += c == '\'' ? string("'\\''") : string(1, c);
+  return q + "'";
+}
+
+int main(int argc, char *argv[])
+{
+  cmdline::parser c;
+
+  c.add<int>   ("verbose",     'v', "verbosity level: 0-4", false, 0);
+  c.add        ("help",        'h', "print this message");
+  c.add<string>("output",      'o', "shared library to write, default: the model file with .so appended", false, "");
+  c.add<string>("compiler",    'c', "command that builds the shared library from the generated source", false, "c++ -O2 -shared -fPIC");
+  c.add        ("source-only", 'S', "only write the generated C++ source");
+  c.footer     ("[classifier-model-file]");
+
+  if (!c.parse(argc,argv,true) || c.exist("help")) {
+    cerr << c.usage() << "\n" << (c.exist("help") ? "" : c.error()) << "\n" ;
+    return c.exist("help") ? 0 : -1;
+  }
+
+  set_verbosity(c.get<int>("verbose"));
+
+  string output = c.get<string>("output");
+  if (output == "" && c.rest().size() == 0) {
+    cerr << "an output file is needed when reading the model from stdin" << endl;
+    return -1;
+  }
+
+  /* load a classification model */
+  ifstream fin; fin.open(c.rest().size() ? c.rest()[0] : "");
+  istream &model = c.rest().size() ? fin : cin;
+  Classifier *classifier = loadClassifierFromFile(model);
+
+  if (classifier == NULL) {
+    cerr << "unable to load classification model" << endl;
+    return -1;
+  }
+
+  if (output == "")
+    output = c.rest()[0] + ".so";
+
+  /* the source is written next to the library, .so replaced by .cpp */
+  string source = output;
+  if (source.size() > 3 && source.compare(source.size()-3, 3, ".so") == 0)
+    source.erase(source.size()-3);
+  source += ".cpp";
+
+  stringstream code;
+  string error;
+  if (!TreeCompiler::emit(classifier, code, error)) {
+    cerr << "unable to compile " << classifier->getClassifierType() << " model: " << error << endl;
+    return -1;
+  }
+
+  ofstream out(source);
+  out << code.str();
+  out.close();
+  if (!out) {
+    cerr << "unable to write " << source << endl;
+    return -1;
+  }
+
+  if (c.exist("source-only"))
+    return 0;
+
+  string command = c.get<string>("compiler") + " -o " + quote(output) + " " + quote(source);
+  if (system(command.c_str()) != 0) {
+    cerr << "building the library failed: " << command << endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,265 @@
+#ifndef _COMPILED_H_
+#define _COMPILED_H_
+
+#include <GRT.h>
+#include <dlfcn.h>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+
+using namespace GRT;
+using namespace std;
+
+/* Entry points of a compiled model library. The predict function reads one
+ * sample, and returns 0 where GRT's prediction would fail, otherwise the
+ * class label and its likelihood are written to label and likelihood. */
+#define GRT_COMPILED_ABI 1
+
+typedef unsigned (*grt_compiled_info_t)(void);
+typedef int (*grt_compiled_predict_t)(const Float *input, unsigned *label, Float *likelihood);
+
+/* Translates trained DecisionTree and RandomForests models into C++ source,
+ * in which each tree is unrolled into nested branches on its split values,
+ * with the class probabilities of its leaves as constants. The evaluation
+ * follows GRT's step by step: inputs are scaled to [0,1] if the model was
+ * trained with scaling, a node sends a sample to its right child if the
+ * feature is at least the threshold, a forest sums the leaves of its trees
+ * in order and multiplies with one over its size, and the first class with
+ * the largest likelihood wins. Constants are written with enough digits to
+ * be read back exactly, so predictions stay identical.
+ *
+ * Only cluster and threshold nodes are translated, models with other node
+ * types or with null rejection can not be compiled (emit returns false). */
+class TreeCompiler {
+  public:
+  static bool emit(Classifier *classifier, ostream &out, string &error) {
+    DecisionTree *tree = dynamic_cast<DecisionTree*>(classifier);
+    RandomForests *forest = dynamic_cast<RandomForests*>(classifier);
+    vector<const DecisionTreeNode*> roots;
+
+    if (tree != NULL)
+      roots.push_back(tree->getTree());
+    else if (forest != NULL)
+      roots.assign(forest->getForest().begin(), forest->getForest().end());
+    else {
+      error = "only DecisionTree and RandomForests models can be compiled";
+      return false;
+    }
+
+    if (!classifier->getTrained() || roots.size() == 0) {
+      error = "the model has not been trained";
+      return false;
+    }
+
+    if (classifier->getNullRejectionEnabled()) {
+      error = "models with null rejection can not be compiled";
+      return false;
+    }
+
+    UINT dims = classifier->getNumInputDimensions(), classes = classifier->getNumClasses();
+    Vector<UINT> labels = classifier->getClassLabels();
+    Vector<MinMax> ranges = classifier->getRanges();
+    bool scaling = classifier->getScalingEnabled();
+
+    if (dims == 0 || classes == 0 || labels.size() != classes || (scaling && ranges.size() != dims)) {
+      error = "the model is inconsistent";
+      return false;
+    }
+
+    /* the trees are translated first, so nothing is written on errors */
+    stringstream trees;
+    for (size_t i=0; i<roots.size(); i++) {
+      trees << "static int tree" << i << "(const Float *x, Float *y)\n{\n";
+      if (!node(roots[i], trees, 1, forest != NULL, dims, classes, error))
+        return false;
+      trees << "  return 1;\n}\n\n";
+    }
+
+    out << "/* compiled from a " << (forest ? "RandomForests" : "DecisionTree") << " model by grt compile */\n\n"
+        << "typedef " << (sizeof(Float) == sizeof(float) ? "float" : "double") << " Float;\n\n"
+        << trees.str();
+
+    out << "extern \"C\" unsigned grt_compiled_abi(void) { return " << GRT_COMPILED_ABI << "; }\n"
+        << "extern \"C\" unsigned grt_compiled_dimensions(void) { return " << dims << "; }\n"
+        << "extern \"C\" unsigned grt_compiled_classes(void) { return " << classes << "; }\n\n";
+
+    out << "extern \"C\" int grt_compiled_predict(const Float *input, unsigned *label, Float *likelihood)\n{\n"
+        << "  static const unsigned labels[" << classes << "] = {";
+    for (size_t k=0; k<classes; k++)
+      out << (k ? ", " : "") << labels[k];
+    out << "};\n"
+        << "  Float y[" << classes << "] = {0};\n";
+
+    /* (x-min)*(1-0)/(max-min)+0 is what GRT computes, without the identities */
+    if (scaling) {
+      out << "  Float x[" << dims << "];\n";
+      for (size_t n=0; n<dims; n++)
+        if (ranges[n].minValue == ranges[n].maxValue)
+          out << "  x[" << n << "] = 0;\n";
+        else
+          out << "  x[" << n << "] = (input[" << n << "] - " << literal(ranges[n].minValue) << ") / ("
+              << literal(ranges[n].maxValue) << " - " << literal(ranges[n].minValue) << ");\n";
+    } else
+      out << "  const Float *x = input;\n";
+
+    out << "\n";
+    for (size_t i=0; i<roots.size(); i++)
+      out << "  if (!tree" << i << "(x, y)) return 0;\n";
+
+    if (forest != NULL)
+      out << "  for (unsigned k=0; k<" << classes << "; k++)\n"
+          << "    y[k] = y[k] * " << literal(1.0 / Float(roots.size())) << ";\n";
+
+    out << "\n"
+        << "  unsigned best = 0;\n"
+        << "  Float max = 0;\n"
+        << "  for (unsigned k=0; k<" << classes << "; k++)\n"
+        << "    if (y[k] > max) {\n"
+        << "      max = y[k];\n"
+        << "      best = k;\n"
+        << "    }\n\n"
+        << "  *label = labels[best];\n"
+        << "  *likelihood = y[best];\n"
+        << "  return 1;\n"
+        << "}\n";
+
+    return true;
+  }
+
+  protected:
+  /* the shortest decimal that reads back as the same value */
+  static string literal(Float v) {
+    if (std::isnan(v)) return "__builtin_nan(\"\")";
+    if (std::isinf(v)) return v > 0 ? "__builtin_inf()" : "-__builtin_inf()";
+
+    char buf[64];
+    for (int precision = 6; precision <= 17; precision++) {
+      snprintf(buf, sizeof(buf), "%.*g", precision, (double) v);
+      if ((Float) strtod(buf, NULL) == v)
+        break;
+    }
+
+    /* keep it a floating point literal of the type of Float */
+    string s(buf);
+    if (s.find_first_of(".e") == string::npos)
+      s += ".0";
+    return sizeof(Float) == sizeof(float) ? s + "f" : s;
+  }
+
+  /* a missing child fails GRT's prediction, so does the generated code */
+  static bool node(const Node *n, ostream &out, int depth, bool sum, UINT dims, UINT classes, string &error) {
+    string indent(2*depth, ' ');
+
+    if (n == NULL) {
+      out << indent << "return 0;\n";
+      return true;
+    }
+
+    if (n->getIsLeafNode()) {
+      const DecisionTreeNode *leaf = dynamic_cast<const DecisionTreeNode*>(n);
+      VectorFloat p = leaf != NULL ? leaf->getClassProbabilities() : VectorFloat();
+      if (p.size() != classes) {
+        error = "a leaf does not hold a probability for each class";
+        return false;
+      }
+      for (size_t k=0; k<classes; k++)
+        out << indent << "y[" << k << "] " << (sum ? "+= " : "= ") << literal(p[k]) << ";\n";
+      return true;
+    }
+
+    UINT feature;
+    Float threshold;
+    if (const DecisionTreeClusterNode *c = dynamic_cast<const DecisionTreeClusterNode*>(n)) {
+      feature = c->getFeatureIndex();
+      threshold = c->getThreshold();
+    } else if (const DecisionTreeThresholdNode *t = dynamic_cast<const DecisionTreeThresholdNode*>(n)) {
+      feature = t->getFeatureIndex();
+      threshold = t->getThreshold();
+    } else {
+      error = "only cluster and threshold nodes can be compiled";
+      return false;
+    }
+
+    if (feature >= dims) {
+      error = "a node splits on a feature beyond the input dimensions";
+      return false;
+    }
+
+    out << indent << "if (x[" << feature << "] >= " << literal(threshold) << ") {\n";
+    if (!node(n->getRightChild(), out, depth+1, sum, dims, classes, error))
+      return false;
+    out << indent << "} else {\n";
+    if (!node(n->getLeftChild(), out, depth+1, sum, dims, classes, error))
+      return false;
+    out << indent << "}\n";
+    return true;
+  }
+};
+
+/* A model library written by grt compile. It has to be used together with
+ * the model it was compiled from, which is checked as far as the input
+ * dimensions and the number of classes go. */
+class CompiledModel {
+  public:
+  UINT predictedClassLabel;
+  Float maxLikelihood;
+
+  static CompiledModel *fromFile(const string &filename, Classifier *classifier) {
+    /* without a slash dlopen would search the library path instead */
+    string path = filename.find('/') == string::npos ? "./" + filename : filename;
+    void *handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+
+    if (handle == NULL) {
+      cerr << dlerror() << endl;
+      return NULL;
+    }
+
+    grt_compiled_info_t abi = (grt_compiled_info_t) dlsym(handle, "grt_compiled_abi"),
+                       dims = (grt_compiled_info_t) dlsym(handle, "grt_compiled_dimensions"),
+                    classes = (grt_compiled_info_t) dlsym(handle, "grt_compiled_classes");
+    grt_compiled_predict_t predict = (grt_compiled_predict_t) dlsym(handle, "grt_compiled_predict");
+
+    if (abi == NULL || dims == NULL || classes == NULL || predict == NULL || abi() != GRT_COMPILED_ABI) {
+      cerr << filename << " is not a model compiled by this version of grt compile" << endl;
+      dlclose(handle);
+      return NULL;
+    }
+
+    if (dims() != classifier->getNumInputDimensions() || classes() != classifier->getNumClasses()) {
+      cerr << filename << " was compiled from a different model" << endl;
+      dlclose(handle);
+      return NULL;
+    }
+
+    return new CompiledModel(handle, predict, dims());
+  }
+
+  ~CompiledModel() {
+    dlclose(handle);
+  }
+
+  bool predict(const VectorFloat &x) {
+    unsigned label;
+    Float likelihood;
+
+    if (x.size() != dims || !function(&x[0], &label, &likelihood))
+      return false;
+
+    predictedClassLabel = label;
+    maxLikelihood = likelihood;
+    return true;
+  }
+
+  protected:
+  CompiledModel(void *handle, grt_compiled_predict_t function, UINT dims)
+    : predictedClassLabel(0), maxLikelihood(0), handle(handle), function(function), dims(dims) {}
+
+  void *handle;
+  grt_compiled_predict_t function;
+  UINT dims;
+};
+
+#endif
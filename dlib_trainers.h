@@ -12,6 +12,10 @@
 #include <dlib/svm_threaded.h>
 
 #include <map>
+#include <cctype>
+#include <algorithm>
+#include <streambuf>
+#include <stdint.h>
 
 #include "enum.h"
 
@@ -58,6 +62,17 @@ BETTER_ENUM(TrainerName, int,
   SVR_LINEAR
 )
 
+// kernels of the binary trainers as stored in a model, NONE for trainers without a kernel option
+BETTER_ENUM(KernelName, int,
+  NONE,
+  HIST,
+  LIN,
+  LIN_NO,
+  RBF,
+  POLY,
+  SIG
+)
+
 multimap<TrainerType, TrainerName> type_name_map = {
   {TrainerType::MULTICLASS, TrainerName::ONE_VS_ONE},
   {TrainerType::MULTICLASS, TrainerName::ONE_VS_ALL},
@@ -129,48 +144,233 @@ std::vector<string> classifierGetType(TrainerType type) {
 typedef matrix<double, 0, 1> sample_type;
 typedef string label_type;
 
-typedef std::vector<sample_type> v_sample_type;
 typedef std::vector<label_type> v_label_type;
 
-// any typedefs
-typedef any_trainer<sample_type, label_type> a_tr;
-typedef any_decision_function<sample_type, label_type> a_df;
+// all types that depend on the sample type. besides the dynamically sized sample_type, fixed size samples
+// are used for common numbers of dimensions (see dispatch_dims), for which the compiler can unroll and
+// vectorize the kernel evaluations.
+//_______________________________________________________________________________________________________
+template <typename S>
+struct sample_traits {
+  typedef S sample_type;
+  typedef std::vector<sample_type> v_sample_type;
+
+  // any typedefs
+  typedef any_trainer<sample_type, label_type> a_tr;
+  typedef any_decision_function<sample_type, label_type> a_df;
+
+  // kernel typedefs
+  typedef histogram_intersection_kernel<sample_type> hist_kernel;
+  typedef linear_kernel<sample_type> lin_kernel;
+  typedef radial_basis_kernel<sample_type> rbf_kernel;
+  typedef polynomial_kernel<sample_type> poly_kernel;
+  typedef sigmoid_kernel<sample_type> sig_kernel;
+
+  // individual trainer typedefs
+
+  // one vs one trainer typedefs
+  typedef one_vs_one_trainer<any_trainer<sample_type>, label_type> ovo_trainer_type;
+  typedef one_vs_one_decision_function<ovo_trainer_type> ovo_trained_function_type;
+  typedef one_vs_one_decision_function<ovo_trainer_type, decision_function<offset_kernel<hist_kernel>>> ovo_trained_function_type_hist_df;
+  typedef one_vs_one_decision_function<ovo_trainer_type, decision_function<offset_kernel<lin_kernel>>> ovo_trained_function_type_lin_df;
+  typedef one_vs_one_decision_function<ovo_trainer_type, decision_function<lin_kernel>> ovo_trained_function_type_lin_no_df;
+  typedef one_vs_one_decision_function<ovo_trainer_type, decision_function<offset_kernel<rbf_kernel>>> ovo_trained_function_type_rbf_df;
+  typedef one_vs_one_decision_function<ovo_trainer_type, decision_function<offset_kernel<poly_kernel>>> ovo_trained_function_type_poly_df;
+  typedef one_vs_one_decision_function<ovo_trainer_type, decision_function<offset_kernel<sig_kernel>>> ovo_trained_function_type_sig_df;
+
+  // one vs all trainer typedefs
+  typedef one_vs_all_trainer<any_trainer<sample_type>, label_type> ova_trainer_type;
+  typedef one_vs_all_decision_function<ova_trainer_type> ova_trained_function_type;
+  typedef one_vs_all_decision_function<ova_trainer_type, decision_function<offset_kernel<hist_kernel>>> ova_trained_function_type_hist_df;
+  typedef one_vs_all_decision_function<ova_trainer_type, decision_function<offset_kernel<lin_kernel>>> ova_trained_function_type_lin_df;
+  typedef one_vs_all_decision_function<ova_trainer_type, decision_function<lin_kernel>> ova_trained_function_type_lin_no_df;
+  typedef one_vs_all_decision_function<ova_trainer_type, decision_function<offset_kernel<rbf_kernel>>> ova_trained_function_type_rbf_df;
+  typedef one_vs_all_decision_function<ova_trainer_type, decision_function<offset_kernel<poly_kernel>>> ova_trained_function_type_poly_df;
+  typedef one_vs_all_decision_function<ova_trainer_type, decision_function<offset_kernel<sig_kernel>>> ova_trained_function_type_sig_df;
+
+  // svm multiclass linear trainer typedefs
+  typedef svm_multiclass_linear_trainer<lin_kernel, label_type> svm_ml_trainer_type;
+  typedef multiclass_linear_decision_function<lin_kernel, label_type> svm_ml_trained_function_type;
+};
 
-// kernel typedefs
-typedef histogram_intersection_kernel<sample_type> hist_kernel;
-typedef linear_kernel<sample_type> lin_kernel;
-typedef radial_basis_kernel<sample_type> rbf_kernel;
-typedef polynomial_kernel<sample_type> poly_kernel;
-typedef sigmoid_kernel<sample_type> sig_kernel;
+// imports the sample_traits of S into the scope of a template, so that the typedefs can be used unqualified.
+// most scopes only use a few of them, so they are all marked as possibly unused.
+#define SAMPLE_TRAITS(S) \
+  typedef sample_traits<S> traits __attribute__((unused)); \
+  typedef typename traits::sample_type sample_type __attribute__((unused)); \
+  typedef typename traits::v_sample_type v_sample_type __attribute__((unused)); \
+  typedef typename traits::a_tr a_tr __attribute__((unused)); \
+  typedef typename traits::a_df a_df __attribute__((unused)); \
+  typedef typename traits::hist_kernel hist_kernel __attribute__((unused)); \
+  typedef typename traits::lin_kernel lin_kernel __attribute__((unused)); \
+  typedef typename traits::rbf_kernel rbf_kernel __attribute__((unused)); \
+  typedef typename traits::poly_kernel poly_kernel __attribute__((unused)); \
+  typedef typename traits::sig_kernel sig_kernel __attribute__((unused)); \
+  typedef typename traits::ovo_trainer_type ovo_trainer_type __attribute__((unused)); \
+  typedef typename traits::ovo_trained_function_type ovo_trained_function_type __attribute__((unused)); \
+  typedef typename traits::ovo_trained_function_type_hist_df ovo_trained_function_type_hist_df __attribute__((unused)); \
+  typedef typename traits::ovo_trained_function_type_lin_df ovo_trained_function_type_lin_df __attribute__((unused)); \
+  typedef typename traits::ovo_trained_function_type_lin_no_df ovo_trained_function_type_lin_no_df __attribute__((unused)); \
+  typedef typename traits::ovo_trained_function_type_rbf_df ovo_trained_function_type_rbf_df __attribute__((unused)); \
+  typedef typename traits::ovo_trained_function_type_poly_df ovo_trained_function_type_poly_df __attribute__((unused)); \
+  typedef typename traits::ovo_trained_function_type_sig_df ovo_trained_function_type_sig_df __attribute__((unused)); \
+  typedef typename traits::ova_trainer_type ova_trainer_type __attribute__((unused)); \
+  typedef typename traits::ova_trained_function_type ova_trained_function_type __attribute__((unused)); \
+  typedef typename traits::ova_trained_function_type_hist_df ova_trained_function_type_hist_df __attribute__((unused)); \
+  typedef typename traits::ova_trained_function_type_lin_df ova_trained_function_type_lin_df __attribute__((unused)); \
+  typedef typename traits::ova_trained_function_type_lin_no_df ova_trained_function_type_lin_no_df __attribute__((unused)); \
+  typedef typename traits::ova_trained_function_type_rbf_df ova_trained_function_type_rbf_df __attribute__((unused)); \
+  typedef typename traits::ova_trained_function_type_poly_df ova_trained_function_type_poly_df __attribute__((unused)); \
+  typedef typename traits::ova_trained_function_type_sig_df ova_trained_function_type_sig_df __attribute__((unused)); \
+  typedef typename traits::svm_ml_trainer_type svm_ml_trainer_type __attribute__((unused)); \
+  typedef typename traits::svm_ml_trained_function_type svm_ml_trained_function_type __attribute__((unused));
 
 #define KERNEL_TYPE "list", "hist", "lin", "rbf", "poly", "sig"
 
 
-// individual trainer typedefs
+// tag to pass a sample type to a generic lambda, e.g. [&](auto tag) { typedef typename decltype(tag)::type S; }
+template <typename S>
+struct sample_tag { typedef S type; };
+
+// calls f with the fixed size sample type for the given number of dimensions, e.g. the 3-axis accelerometer
+// and its multiples, or with the dynamically sized one otherwise. T is the scalar type of the samples. each
+// fixed size multiplies the compile time, define DLIB_DYNAMIC_SAMPLES_ONLY to build only the dynamic one.
+//_______________________________________________________________________________________________________
+template <typename T, typename F>
+auto dispatch_dims(long dims, F f) -> decltype(f(sample_tag<sample_type>())) {
+#ifndef DLIB_DYNAMIC_SAMPLES_ONLY
+  switch (dims) {
+    case 3:  return f(sample_tag<matrix<T, 3, 1>>());
+    case 6:  return f(sample_tag<matrix<T, 6, 1>>());
+    case 9:  return f(sample_tag<matrix<T, 9, 1>>());
+    case 12: return f(sample_tag<matrix<T, 12, 1>>());
+    case 24: return f(sample_tag<matrix<T, 24, 1>>());
+    case 48: return f(sample_tag<matrix<T, 48, 1>>());
+  }
+#endif
+  (void) dims;
+  return f(sample_tag<matrix<T, 0, 1>>());
+}
+
+// wraps a binary kernel trainer, so that its decision functions are approximated by at most num_bv basis
+// vectors (see dlib's reduced2). prediction cost is linear in the number of basis vectors, 0 keeps all.
+//_______________________________________________________________________________________________________
+template <typename T>
+any_trainer<typename T::sample_type> reducible(const T &trainer, unsigned long num_bv) {
+  if (num_bv > 0)
+    return reduced2(trainer, num_bv);
+  return trainer;
+}
+
+#define PRECISION_TYPE "double", "float"
+
+// same as dispatch_dims, with the scalar type given by its name in PRECISION_TYPE. float samples halve the
+// memory bandwidth of kernel evaluations, sensor data is rarely more accurate than that anyway.
+//_______________________________________________________________________________________________________
+template <typename F>
+auto dispatch_sample_type(const string &precision, long dims, F f) -> decltype(f(sample_tag<sample_type>())) {
+  if (precision == "float")
+    return dispatch_dims<float>(dims, f);
+  return dispatch_dims<double>(dims, f);
+}
+
+
+// labelled samples in one contiguous row-major buffer, instead of a separately allocated matrix per sample.
+// samples are copied into matrices only where needed, e.g. for the trainers or one reused prediction input.
+//_______________________________________________________________________________________________________
+class sample_store {
+ public:
+  std::vector<double> values;
+  v_label_type labels;
+  long dims = 0;
+  size_t offset = 0; // number of samples before the current ones, which were dropped by clear()
+  bool end = false;  // set when the empty line after the samples or the end of the input has been reached
+  bool stop_at_blank = true; // otherwise empty lines are skipped and samples are read until the end of the input
+
+  size_t size() const { return labels.size(); }
+
+  // drop the current samples to read the next ones, the buffers keep their capacity
+  void clear() {
+    offset += size();
+    values.clear();
+    labels.clear();
+  }
 
-// one vs one trainer typedefs
-typedef one_vs_one_trainer<any_trainer<sample_type>, label_type> ovo_trainer_type;
-typedef one_vs_one_decision_function<ovo_trainer_type> ovo_trained_function_type;
-typedef one_vs_one_decision_function<ovo_trainer_type, decision_function<offset_kernel<hist_kernel>>> ovo_trained_function_type_hist_df;
-typedef one_vs_one_decision_function<ovo_trainer_type, decision_function<offset_kernel<lin_kernel>>> ovo_trained_function_type_lin_df;
-typedef one_vs_one_decision_function<ovo_trainer_type, decision_function<lin_kernel>> ovo_trained_function_type_lin_no_df;
-typedef one_vs_one_decision_function<ovo_trainer_type, decision_function<offset_kernel<rbf_kernel>>> ovo_trained_function_type_rbf_df;
-typedef one_vs_one_decision_function<ovo_trainer_type, decision_function<offset_kernel<poly_kernel>>> ovo_trained_function_type_poly_df;
-typedef one_vs_one_decision_function<ovo_trainer_type, decision_function<offset_kernel<sig_kernel>>> ovo_trained_function_type_sig_df;
+  const double* row(size_t i) const { return values.data() + i * dims; }
 
-// one vs all trainer typedefs
-typedef one_vs_all_trainer<any_trainer<sample_type>, label_type> ova_trainer_type;
-typedef one_vs_all_decision_function<ova_trainer_type> ova_trained_function_type;
-typedef one_vs_all_decision_function<ova_trainer_type, decision_function<offset_kernel<hist_kernel>>> ova_trained_function_type_hist_df;
-typedef one_vs_all_decision_function<ova_trainer_type, decision_function<offset_kernel<lin_kernel>>> ova_trained_function_type_lin_df;
-typedef one_vs_all_decision_function<ova_trainer_type, decision_function<lin_kernel>> ova_trained_function_type_lin_no_df;
-typedef one_vs_all_decision_function<ova_trainer_type, decision_function<offset_kernel<rbf_kernel>>> ova_trained_function_type_rbf_df;
-typedef one_vs_all_decision_function<ova_trainer_type, decision_function<offset_kernel<poly_kernel>>> ova_trained_function_type_poly_df;
-typedef one_vs_all_decision_function<ova_trainer_type, decision_function<offset_kernel<sig_kernel>>> ova_trained_function_type_sig_df;
+  // copy the i-th sample into the given column vector, which is only resized if needed
+  template <typename M>
+  void copy_to(size_t i, M &sample) const {
+    if (sample.size() != dims)
+      sample.set_size(dims);
+    const double *r = row(i);
+    for (long j = 0; j < dims; ++j)
+      sample(j) = r[j];
+  }
 
-// svm multiclass linear trainer typedefs
-typedef svm_multiclass_linear_trainer<lin_kernel, label_type> svm_ml_trainer_type;
-typedef multiclass_linear_decision_function<lin_kernel, label_type> svm_ml_trained_function_type;
+  // samples and labels at the given indices
+  template <typename M>
+  void select(const std::vector<size_t> &idx, std::vector<M> &samples, v_label_type &l) const {
+    samples.resize(idx.size());
+    l.resize(idx.size());
+    for (size_t i = 0; i < idx.size(); ++i) {
+      copy_to(idx[i], samples[i]);
+      l[i] = labels[idx[i]];
+    }
+  }
+
+  // read one sample per line, a label followed by its values, until the first empty line after some samples,
+  // or until max samples have been read if max is not 0. comments and lines without values are skipped.
+  // returns false if the number of values differs between lines.
+  bool read(istream &in, size_t max = 0) {
+    string line;
+
+    while (max == 0 || size() < max) {
+      if (!getline(in, line)) {
+        end = true;
+        break;
+      }
+
+      if (line.find_first_not_of(" \t") == string::npos) {
+        if (stop_at_blank && offset + size() != 0) {
+          end = true;
+          break;
+        }
+        else
+          continue;
+      }
+
+      if (line[0] == '#')
+        continue;
+
+      const char *p = line.c_str(), *label;
+      while (isspace((unsigned char) *p)) ++p;
+      for (label = p; *p && !isspace((unsigned char) *p); ++p);
+
+      size_t begin = values.size();
+      const char *label_end = p;
+      while (true) {
+        while (isspace((unsigned char) *p)) ++p;
+        if (!*p) break;
+        values.push_back(strtod(p, NULL)); // this also handles nan and infs correctly
+        while (*p && !isspace((unsigned char) *p)) ++p;
+      }
+
+      long n = values.size() - begin;
+      if (n == 0)
+        continue;
+
+      if (dims == 0)
+        dims = n;
+      if (n != dims)
+        return false;
+
+      labels.push_back(string(label, label_end));
+    }
+
+    return true;
+  }
+};
 
 
 
@@ -185,9 +385,13 @@ typedef multiclass_linear_decision_function<lin_kernel, label_type> svm_ml_train
 */
 
 //_______________________________________________________________________________________________________
+template <typename S>
 class trainer_template {
  public:
+  SAMPLE_TRAITS(S)
+
   trainer_template() {}
+  virtual ~trainer_template() {}
 
   TrainerType getTrainerType() { return m_trainer_type; }
   TrainerName getTrainerName() { return m_trainer_name; }
@@ -212,7 +416,46 @@ class trainer_template {
     return m_trainer.train(all_samples, all_labels);
   }
 
-  virtual matrix<double> crossValidation(const v_sample_type& samples, const v_label_type& labels, const long folds) = 0;
+  // confusion matrix of one fold of a stratified k-fold cross-validation, split like dlib's
+  // cross_validate_multiclass_trainer does. of each class count/folds consecutive samples are held out for
+  // testing in each fold, the remaining count%folds samples are never tested. the training samples are
+  // added class by class, each class starting after its held-out block and wrapping around. rows are the
+  // true and columns the predicted labels, both ordered as by select_all_distinct_labels(). the training
+  // samples are copied for the trainer, the held-out ones are predicted in place.
+  matrix<double> crossValidateFold(const v_sample_type& samples, const v_label_type& labels, const long folds, const long fold) const {
+    v_label_type distinct = select_all_distinct_labels(labels);
+    std::map<label_type, long> index;
+    for (size_t i = 0; i < distinct.size(); ++i)
+      index[distinct[i]] = i;
+
+    std::vector<std::vector<size_t>> members(distinct.size());
+    for (size_t i = 0; i < labels.size(); ++i)
+      members[index[labels[i]]].push_back(i);
+
+    v_sample_type train_samples;
+    v_label_type train_labels;
+    for (size_t c = 0; c < distinct.size(); ++c) {
+      long count = members[c].size(), in_test = count / folds;
+      for (long j = 0; j < count - in_test; ++j) {
+        train_samples.push_back(samples[members[c][((fold + 1) * in_test + j) % count]]);
+        train_labels.push_back(distinct[c]);
+      }
+    }
+
+    // like dlib, a fold on which the trainer finds nu invalid adds nothing
+    matrix<double> confusion = zeros_matrix<double>(distinct.size(), distinct.size());
+    try {
+      a_df df = train(train_samples, train_labels);
+      for (size_t c = 0; c < distinct.size(); ++c) {
+        long in_test = members[c].size() / folds;
+        for (long j = fold * in_test; j < (fold + 1) * in_test; ++j)
+          confusion(c, index[df(samples[members[c][j]])]) += 1;
+      }
+    } catch (invalid_nu_error&) {
+    }
+
+    return confusion;
+  }
 
  protected:
   void setTrainerType(TrainerType type) { m_trainer_type = type; }
@@ -247,32 +490,26 @@ class trainer_template {
 */
 
 //_______________________________________________________________________________________________________
-class ovo_trainer : public trainer_template {
+template <typename S>
+class ovo_trainer : public trainer_template<S> {
  public:
+  SAMPLE_TRAITS(S)
   typedef ovo_trainer_type T;
 
   ovo_trainer(bool verbose = false, int num_threads = 4, string kernel = "", any_trainer<sample_type> bin_tr = krr_trainer<rbf_kernel>()) {
-    setTrainerType(TrainerType::MULTICLASS);
-    setTrainerName(TrainerName::ONE_VS_ONE);
-    m_verbose = verbose;
-    m_kernel = kernel;
+    this->setTrainerType(TrainerType::MULTICLASS);
+    this->setTrainerName(TrainerName::ONE_VS_ONE);
+    this->m_verbose = verbose;
+    this->m_kernel = kernel;
 
-    m_trainer.clear();
-    m_trainer.get<T>();
+    this->m_trainer.clear();
+    this->m_trainer.template get<T>();
 
-    m_trainer.cast_to<T>().set_trainer(bin_tr);
+    this->m_trainer.template cast_to<T>().set_trainer(bin_tr);
 
-    m_trainer.cast_to<T>().set_num_threads(num_threads);
-    if (m_verbose)
-      m_trainer.cast_to<T>().be_verbose();
-  }
-
-  matrix<double> crossValidation(const v_sample_type& samples, const v_label_type& labels, const long folds = 5) {
-    if (m_trainer.is_empty()) {
-      cerr << "Trainer not set!" << endl;
-      exit(-1);
-    }
-    return cross_validate_multiclass_trainer(m_trainer.cast_to<T>(), samples, labels, folds);
+    this->m_trainer.template cast_to<T>().set_num_threads(num_threads);
+    if (this->m_verbose)
+      this->m_trainer.template cast_to<T>().be_verbose();
   }
 };
 
@@ -289,32 +526,26 @@ class ovo_trainer : public trainer_template {
 */
 
 //_______________________________________________________________________________________________________
-class ova_trainer : public trainer_template {
+template <typename S>
+class ova_trainer : public trainer_template<S> {
  public:
+  SAMPLE_TRAITS(S)
   typedef ova_trainer_type T;
 
   ova_trainer(bool verbose = false, int num_threads = 4, string kernel = "", any_trainer<sample_type> bin_tr = krr_trainer<rbf_kernel>()) {
-    setTrainerType(TrainerType::MULTICLASS);
-    setTrainerName(TrainerName::ONE_VS_ALL);
-    m_verbose = verbose;
-    m_kernel = kernel;
+    this->setTrainerType(TrainerType::MULTICLASS);
+    this->setTrainerName(TrainerName::ONE_VS_ALL);
+    this->m_verbose = verbose;
+    this->m_kernel = kernel;
 
-    m_trainer.clear();
-    m_trainer.get<T>();
+    this->m_trainer.clear();
+    this->m_trainer.template get<T>();
 
-    m_trainer.cast_to<T>().set_trainer(bin_tr);
+    this->m_trainer.template cast_to<T>().set_trainer(bin_tr);
 
-    m_trainer.cast_to<T>().set_num_threads(num_threads);
-    if (m_verbose)
-      m_trainer.cast_to<T>().be_verbose();
-  }
-
-  matrix<double> crossValidation(const v_sample_type& samples, const v_label_type& labels, const long folds = 5) {
-    if (m_trainer.is_empty()) {
-      cerr << "Trainer not set!" << endl;
-      exit(-1);
-    }
-    return cross_validate_multiclass_trainer(m_trainer.cast_to<T>(), samples, labels, folds);
+    this->m_trainer.template cast_to<T>().set_num_threads(num_threads);
+    if (this->m_verbose)
+      this->m_trainer.template cast_to<T>().be_verbose();
   }
 };
 
@@ -331,38 +562,394 @@ class ova_trainer : public trainer_template {
 */
 
 //_______________________________________________________________________________________________________
-class svm_ml_trainer : public trainer_template {
+template <typename S>
+class svm_ml_trainer : public trainer_template<S> {
  public:
+  SAMPLE_TRAITS(S)
   typedef svm_ml_trainer_type T;
 
   svm_ml_trainer(bool verbose = false, int num_threads = 4, bool nonneg = false, double epsilon = 0.001, int iterations = 10000, double regularization = 1) {
-    setTrainerType(TrainerType::MULTICLASS);
-    setTrainerName(TrainerName::SVM_MULTICLASS_LINEAR);
-    m_verbose = verbose;
+    this->setTrainerType(TrainerType::MULTICLASS);
+    this->setTrainerName(TrainerName::SVM_MULTICLASS_LINEAR);
+    this->m_verbose = verbose;
 
-    m_trainer.clear();
-    m_trainer.get<T>();
+    this->m_trainer.clear();
+    this->m_trainer.template get<T>();
 
-    m_trainer.cast_to<T>().set_learns_nonnegative_weights(nonneg);
-    m_trainer.cast_to<T>().set_epsilon(epsilon);
-    m_trainer.cast_to<T>().set_max_iterations(iterations);
-    m_trainer.cast_to<T>().set_c(regularization);
+    this->m_trainer.template cast_to<T>().set_learns_nonnegative_weights(nonneg);
+    this->m_trainer.template cast_to<T>().set_epsilon(epsilon);
+    this->m_trainer.template cast_to<T>().set_max_iterations(iterations);
+    this->m_trainer.template cast_to<T>().set_c(regularization);
 
-    m_trainer.cast_to<T>().set_num_threads(num_threads);
-    if (m_verbose)
-      m_trainer.cast_to<T>().be_verbose();
+    this->m_trainer.template cast_to<T>().set_num_threads(num_threads);
+    if (this->m_verbose)
+      this->m_trainer.template cast_to<T>().be_verbose();
   }
+};
 
-  matrix<double> crossValidation(const v_sample_type& samples, const v_label_type& labels, const long folds = 5) {
-    if (m_trainer.is_empty()) {
-      cerr << "Trainer not set!" << endl;
-      exit(-1);
+
+
+
+/*
+ *   ### LINEARIZED DECISION FUNCTIONS ###
+ */
+
+// weight vector and bias of a linear binary decision function, so that its score is w*x - b. the kernel
+// sum over all basis vectors collapses into one weight vector, an offset kernel into the bias.
+//_______________________________________________________________________________________________________
+template <typename S>
+void collapse(const decision_function<linear_kernel<S>> &df, matrix<typename S::type, 0, 1> &w, typename S::type &b) {
+  long dims = df.basis_vectors.size() > 0 ? df.basis_vectors(0).size() : 0;
+  w = zeros_matrix<typename S::type>(dims, 1);
+  for (long i = 0; i < df.basis_vectors.size(); ++i)
+    for (long j = 0; j < dims; ++j)
+      w(j) += df.alpha(i) * df.basis_vectors(i)(j);
+  b = df.b;
+}
+
+template <typename S>
+void collapse(const decision_function<offset_kernel<linear_kernel<S>>> &df, matrix<typename S::type, 0, 1> &w, typename S::type &b) {
+  decision_function<linear_kernel<S>> plain(df.alpha, df.b, linear_kernel<S>(), df.basis_vectors);
+  collapse(plain, w, b);
+  b -= df.kernel_function.offset * sum(df.alpha);
+}
+
+// ovo/ova decision function of linear binary classifiers. their weight vectors are stacked into the rows of
+// one matrix, so the scores of all classifiers are a single matrix-vector product. votes and ties are
+// resolved in the same order as by dlib's one_vs_one/one_vs_all_decision_function.
+//_______________________________________________________________________________________________________
+template <typename S>
+class linear_multiclass_df {
+ public:
+  typedef typename S::type scalar_type;
+  typedef S sample_type;
+  typedef label_type result_type;
+
+  template <typename T, typename DF>
+  explicit linear_multiclass_df(const one_vs_one_decision_function<T, DF> &ovo) : m_one_vs_one(true) {
+    for (auto &bdf : ovo.get_binary_decision_functions()) {
+      m_labels.push_back(bdf.first.first);
+      m_labels.push_back(bdf.first.second);
+    }
+    unique_labels();
+
+    for (auto &bdf : ovo.get_binary_decision_functions())
+      add(bdf.second.template cast_to<DF>(), index(bdf.first.first), index(bdf.first.second));
+    stack();
+  }
+
+  template <typename T, typename DF>
+  explicit linear_multiclass_df(const one_vs_all_decision_function<T, DF> &ova) : m_one_vs_one(false) {
+    for (auto &bdf : ova.get_binary_decision_functions())
+      m_labels.push_back(bdf.first);
+    unique_labels();
+
+    for (auto &bdf : ova.get_binary_decision_functions())
+      add(bdf.second.template cast_to<DF>(), index(bdf.first), -1);
+    stack();
+  }
+
+  result_type operator()(const sample_type &sample) const {
+    thread_local matrix<scalar_type, 0, 1> scores;
+    thread_local std::vector<long> votes;
+
+    scores = m_weights * sample - m_bias;
+
+    long best = 0;
+    if (m_one_vs_one) {
+      votes.assign(m_labels.size(), 0);
+      for (long r = 0; r < scores.size(); ++r)
+        votes[scores(r) > 0 ? m_pairs[r].first : m_pairs[r].second]++;
+      for (size_t l = 1; l < votes.size(); ++l)
+        if (votes[l] > votes[best])
+          best = l;
+    }
+    else {
+      for (long r = 1; r < scores.size(); ++r)
+        if (scores(r) > scores(best))
+          best = r;
+      best = m_pairs[best].first;
+    }
+
+    return m_labels[best];
+  }
+
+ private:
+  template <typename DF>
+  void add(const DF &df, long positive, long negative) {
+    matrix<scalar_type, 0, 1> w;
+    scalar_type b;
+    collapse(df, w, b);
+    m_rows.push_back(w);
+    m_biases.push_back(b);
+    m_pairs.push_back(make_pair(positive, negative));
+  }
+
+  void stack() {
+    long dims = m_rows.size() > 0 ? m_rows[0].size() : 0;
+    m_weights.set_size(m_rows.size(), dims);
+    m_bias.set_size(m_rows.size());
+    for (size_t r = 0; r < m_rows.size(); ++r) {
+      set_rowm(m_weights, r) = trans(m_rows[r]);
+      m_bias(r) = m_biases[r];
+    }
+    m_rows.clear();
+    m_biases.clear();
+  }
+
+  void unique_labels() {
+    std::sort(m_labels.begin(), m_labels.end());
+    m_labels.erase(std::unique(m_labels.begin(), m_labels.end()), m_labels.end());
+  }
+
+  long index(const label_type &label) const {
+    return std::lower_bound(m_labels.begin(), m_labels.end(), label) - m_labels.begin();
+  }
+
+  bool m_one_vs_one;
+  std::vector<label_type> m_labels;
+  std::vector<std::pair<long, long>> m_pairs; // label indices voted for by a positive and negative score
+  matrix<scalar_type> m_weights;
+  matrix<scalar_type, 0, 1> m_bias;
+  std::vector<matrix<scalar_type, 0, 1>> m_rows;
+  std::vector<scalar_type> m_biases;
+};
+
+
+
+/*
+ *   ### MODEL FILES ###
+ */
+
+// fixed size header in front of every serialized model, all fields are stored little-endian. size and
+// checksum (32-bit FNV-1a) cover the serialized decision function that follows the header.
+//_______________________________________________________________________________________________________
+struct model_header {
+  static const uint32_t magic = 0x44545247; // "GRTD"
+  static const uint16_t current_version = 1;
+  static const size_t length = 32;
+
+  uint16_t version = current_version;
+  uint16_t trainer = TrainerName::TEMPLATE;
+  uint16_t kernel = KernelName::NONE;
+  uint16_t precision = sizeof(double); // bytes per scalar
+  uint32_t dims = 0;
+  uint32_t classes = 0;
+  uint64_t size = 0;
+  uint32_t checksum = 0;
+
+  string precisionName() const { return precision == sizeof(float) ? "float" : "double"; }
+};
+
+uint32_t fnv1a(const char *data, size_t size) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; ++i)
+    hash = (hash ^ (unsigned char) data[i]) * 16777619u;
+  return hash;
+}
+
+// kernel name as given by trainer_template::getKernel(), "n/a" for none
+KernelName kernelFromString(const string &kernel) {
+  if (!KernelName::_is_valid_nocase(kernel.c_str()))
+    return KernelName::NONE;
+  return KernelName::_from_string_nocase(kernel.c_str());
+}
+
+void writeHeader(ostream &out, const model_header &h) {
+  char buf[model_header::length] = {0};
+  auto put = [&](size_t pos, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i)
+      buf[pos + i] = (value >> (8 * i)) & 0xff;
+  };
+
+  put(0, model_header::magic, 4);
+  put(4, h.version, 2);
+  put(6, h.trainer, 2);
+  put(8, h.kernel, 2);
+  put(10, h.precision, 2);
+  put(12, h.dims, 4);
+  put(16, h.classes, 4);
+  put(20, h.size, 8);
+  put(28, h.checksum, 4);
+  out.write(buf, model_header::length);
+}
+
+// reads the binary header, or the two text lines of older models: the trainer and the kernel. those have
+// no size and checksum, and were always trained on double samples of any number of dimensions.
+//_______________________________________________________________________________________________________
+bool readHeader(istream &in, model_header &h) {
+  char buf[model_header::length];
+  auto get = [&](size_t pos, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i)
+      value |= (uint64_t) (unsigned char) buf[pos + i] << (8 * i);
+    return value;
+  };
+
+  if (!in.read(buf, 4))
+    return false;
+
+  if (get(0, 4) == model_header::magic) {
+    if (!in.read(buf + 4, model_header::length - 4))
+      return false;
+    h.version = get(4, 2);
+    h.trainer = get(6, 2);
+    h.kernel = get(8, 2);
+    h.precision = get(10, 2);
+    h.dims = get(12, 4);
+    h.classes = get(16, 4);
+    h.size = get(20, 8);
+    h.checksum = get(28, 4);
+    return h.version <= model_header::current_version && TrainerName::_from_integral_nothrow(h.trainer) &&
+           KernelName::_from_integral_nothrow(h.kernel);
+  }
+
+  string trainer(buf, 4), rest, kernel;
+  getline(in, rest);
+  getline(in, kernel);
+  trainer += rest;
+
+  if (!TrainerName::_is_valid_nocase(trainer.c_str()))
+    return false;
+
+  h.version = 0;
+  h.trainer = TrainerName::_from_string_nocase(trainer.c_str());
+  h.kernel = h.trainer == TrainerName::SVM_MULTICLASS_LINEAR ? +KernelName::NONE : kernelFromString(kernel);
+  h.precision = sizeof(double);
+  h.dims = 0;
+  return true;
+}
+
+// read-only stream over a block of memory, so that the model body is deserialized without another copy
+//_______________________________________________________________________________________________________
+struct memory_buffer : std::streambuf {
+  memory_buffer(char *begin, size_t size) { setg(begin, begin, begin + size); }
+};
+
+// how each combination of trainer and kernel is serialized. the trainers return the generic multiclass
+// decision function, which is converted to the kernel specific one for storage. new kernels only need an
+// entry in table().
+//_______________________________________________________________________________________________________
+template <typename S>
+struct model_format {
+  SAMPLE_TRAITS(S)
+
+  typedef void (*save_function)(const a_df&, ostream&);
+  typedef a_df (*load_function)(istream&);
+  typedef std::map<std::pair<int, int>, std::pair<save_function, load_function>> table_type;
+
+  template <typename G, typename DF>
+  static void save(const a_df &df, ostream &out) { serialize(DF(df.template cast_to<G>()), out); }
+
+  template <typename DF>
+  static a_df load(istream &in) { DF df; deserialize(df, in); return df; }
+
+  // linear ovo/ova models are collapsed into one weight matrix, see linear_multiclass_df
+  template <typename DF>
+  static a_df load_linear(istream &in) { DF df; deserialize(df, in); return linear_multiclass_df<S>(df); }
+
+  static const table_type& table() {
+    typedef ovo_trained_function_type ovo;
+    typedef ova_trained_function_type ova;
+    static const table_type t = {
+      {{TrainerName::ONE_VS_ONE, KernelName::NONE},   {&save<ovo, ovo>, &load<ovo>}},
+      {{TrainerName::ONE_VS_ONE, KernelName::HIST},   {&save<ovo, ovo_trained_function_type_hist_df>, &load<ovo_trained_function_type_hist_df>}},
+      {{TrainerName::ONE_VS_ONE, KernelName::LIN},    {&save<ovo, ovo_trained_function_type_lin_df>, &load_linear<ovo_trained_function_type_lin_df>}},
+      {{TrainerName::ONE_VS_ONE, KernelName::LIN_NO}, {&save<ovo, ovo_trained_function_type_lin_no_df>, &load_linear<ovo_trained_function_type_lin_no_df>}},
+      {{TrainerName::ONE_VS_ONE, KernelName::RBF},    {&save<ovo, ovo_trained_function_type_rbf_df>, &load<ovo_trained_function_type_rbf_df>}},
+      {{TrainerName::ONE_VS_ONE, KernelName::POLY},   {&save<ovo, ovo_trained_function_type_poly_df>, &load<ovo_trained_function_type_poly_df>}},
+      {{TrainerName::ONE_VS_ONE, KernelName::SIG},    {&save<ovo, ovo_trained_function_type_sig_df>, &load<ovo_trained_function_type_sig_df>}},
+      {{TrainerName::ONE_VS_ALL, KernelName::NONE},   {&save<ova, ova>, &load<ova>}},
+      {{TrainerName::ONE_VS_ALL, KernelName::HIST},   {&save<ova, ova_trained_function_type_hist_df>, &load<ova_trained_function_type_hist_df>}},
+      {{TrainerName::ONE_VS_ALL, KernelName::LIN},    {&save<ova, ova_trained_function_type_lin_df>, &load_linear<ova_trained_function_type_lin_df>}},
+      {{TrainerName::ONE_VS_ALL, KernelName::LIN_NO}, {&save<ova, ova_trained_function_type_lin_no_df>, &load_linear<ova_trained_function_type_lin_no_df>}},
+      {{TrainerName::ONE_VS_ALL, KernelName::RBF},    {&save<ova, ova_trained_function_type_rbf_df>, &load<ova_trained_function_type_rbf_df>}},
+      {{TrainerName::ONE_VS_ALL, KernelName::POLY},   {&save<ova, ova_trained_function_type_poly_df>, &load<ova_trained_function_type_poly_df>}},
+      {{TrainerName::ONE_VS_ALL, KernelName::SIG},    {&save<ova, ova_trained_function_type_sig_df>, &load<ova_trained_function_type_sig_df>}},
+      {{TrainerName::SVM_MULTICLASS_LINEAR, KernelName::NONE}, {&save<svm_ml_trained_function_type, svm_ml_trained_function_type>, &load<svm_ml_trained_function_type>}},
+    };
+    return t;
+  }
+
+  // header and serialized decision function. returns false if the combination of trainer and kernel is unknown.
+  static bool write(ostream &out, model_header h, const a_df &df) {
+    auto entry = table().find(make_pair(h.trainer, h.kernel));
+    if (entry == table().end())
+      return false;
+
+    ostringstream body;
+    entry->second.first(df, body);
+    string bytes = body.str();
+
+    h.precision = sizeof(typename S::type);
+    h.size = bytes.size();
+    h.checksum = fnv1a(bytes.data(), bytes.size());
+    writeHeader(out, h);
+    out.write(bytes.data(), bytes.size());
+    return true;
+  }
+
+  // decision function following the given header. the body is read in one piece and verified, unless the
+  // header is one of an older model without size.
+  static bool read(istream &in, const model_header &h, a_df &df) {
+    auto entry = table().find(make_pair(h.trainer, h.kernel));
+    if (entry == table().end())
+      return false;
+
+    if (h.version == 0) {
+      df = entry->second.second(in);
+      return true;
     }
-    return cross_validate_multiclass_trainer(m_trainer.cast_to<T>(), samples, labels, folds);
+
+    // read in bounded chunks, a corrupt size then fails on the missing bytes instead of being allocated
+    std::vector<char> bytes;
+    for (uint64_t remaining = h.size; remaining > 0; ) {
+      size_t offset = bytes.size(), chunk = (size_t) std::min<uint64_t>(remaining, 1 << 20);
+      bytes.resize(offset + chunk);
+      if (!in.read(bytes.data() + offset, chunk))
+        return false;
+      remaining -= chunk;
+    }
+
+    if (fnv1a(bytes.data(), bytes.size()) != h.checksum)
+      return false;
+
+    memory_buffer buffer(bytes.data(), bytes.size());
+    istream body(&buffer);
+    df = entry->second.second(body);
+    return true;
   }
 };
 
 
 
+/*
+ *   ### CROSS-VALIDATION ###
+ */
+
+// k-fold cross-validation of several trainers on the same samples, e.g. points of a parameter grid. all
+// folds of all trainers are run in parallel on num_threads threads, each of which holds a copy of the
+// training samples of its fold, i.e. about (folds-1)/folds of the samples. the trainers should be built
+// with their share of the threads. returns the summed confusion matrix of each trainer.
+//_______________________________________________________________________________________________________
+template <typename S>
+std::vector<matrix<double>> cross_validate(const std::vector<trainer_template<S>*> &trainers, const typename sample_traits<S>::v_sample_type& samples, const v_label_type& labels, const long folds, const long num_threads) {
+  std::vector<matrix<double>> fold_results(trainers.size() * folds);
+
+  parallel_for(num_threads, 0, fold_results.size(), [&](long i) {
+    fold_results[i] = trainers[i / folds]->crossValidateFold(samples, labels, folds, i % folds);
+  }, 1);
+
+  std::vector<matrix<double>> results(trainers.size());
+  for (size_t t = 0; t < trainers.size(); ++t) {
+    results[t] = fold_results[t * folds];
+    for (long f = 1; f < folds; ++f)
+      results[t] += fold_results[t * folds + f];
+  }
+
+  return results;
+}
+
+
 
 #endif // _DLIB_TRAINERS_H_
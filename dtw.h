@@ -0,0 +1,630 @@
+#ifndef _DTW_H_
+#define _DTW_H_
+
+#include <GRT.h>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <atomic>
+#include <thread>
+#include <cmath>
+
+using namespace GRT;
+using namespace std;
+
+/* GRT's DTW keeps its templates and settings protected, pointers to the
+ * members taken through a derived class give read access to them. */
+struct DTWModel : public DTW {
+  static const Vector<DTWTemplate> &templates(const DTW &d) { return d.*(&DTWModel::templatesBuffer); }
+  static UINT  mode(const DTW &d)       { return d.*(&DTWModel::rejectionMode); }
+  static UINT  metric(const DTW &d)     { return d.*(&DTWModel::distanceMethod); }
+  static bool  constrain(const DTW &d)  { return d.*(&DTWModel::constrainWarpingPath); }
+  static Float band(const DTW &d)       { return d.*(&DTWModel::radius); }
+  static Float threshold(const DTW &d)  { return d.*(&DTWModel::nullRejectionLikelihoodThreshold); }
+  static bool  preprocess(const DTW &d) {
+    return d.*(&DTWModel::useZNormalisation) || d.*(&DTWModel::useSmoothing) ||
+           d.*(&DTWModel::offsetUsingFirstSample);
+  }
+};
+
+/* Replaces GRT's DTW prediction, which fills the full cost matrix of every
+ * template through a recursion. GRT's distance is the mean of the
+ * cumulative costs along the warping path it traces back. Without a
+ * warping constraint the cumulative cost never decreases along that path,
+ * which gives cheap bounds to skip templates with:
+ *
+ *  - LB_Kim: the first cell of the path counts fully into the mean, the
+ *    last one at least 1/(M+N-1) of it.
+ *  - LB_Keogh: every query sample is matched to a template sample, the
+ *    envelope of the template bounds the local cost, weighted by how many
+ *    cells of the path remain at least.
+ *  - early abandoning: the mean of any path prefix bounds the whole mean,
+ *    once all prefixes ending in a row exceed the best distance so far the
+ *    template is dropped.
+ *
+ * Templates are taken in the order of their LB_Kim by a thread per core.
+ * The forward pass keeps two rows of the cumulative cost, the sum and the
+ * length of the path leading to each cell. Its sums are accumulated in the
+ * reverse order of GRT's, so the templates close to the best one are
+ * computed again the way GRT does, and results stay identical.
+ *
+ * With a warping constraint GRT leaves the cells just outside of the band
+ * at their local cost, and the path may run through them, none of the
+ * bounds hold then. All distances are also needed for the likelihoods and
+ * the rejection modes based on them. In both cases every template is
+ * computed like GRT does, restricted to the band, in parallel.
+ *
+ * Models with scaling, z-normalisation, smoothing or offsetting and
+ * normalized distances are left to GRT (fromClassifier returns NULL). */
+class DtwSearch {
+  public:
+  UINT predictedClassLabel;
+  Float maxLikelihood; // only computed with likelihoods enabled
+  size_t pruned;       // number of templates skipped by a bound or abandoned
+
+  static DtwSearch *fromClassifier(Classifier *classifier, bool likelihoods) {
+    DTW *dtw = dynamic_cast<DTW*>(classifier);
+    if (dtw == NULL || !dtw->getTrained() || dtw->getScalingEnabled() || DTWModel::preprocess(*dtw))
+      return NULL;
+
+    UINT metric = DTWModel::metric(*dtw);
+    if (metric != DTW::EUCLIDEAN_DIST && metric != DTW::ABSOLUTE_DIST)
+      return NULL;
+
+    return new DtwSearch(*dtw, likelihoods);
+  }
+
+  DtwSearch(DTW &dtw, bool likelihoods)
+    : predictedClassLabel(0), maxLikelihood(0), pruned(0), fallback(dtw)
+  {
+    const Vector<DTWTemplate> &buffer = DTWModel::templates(dtw);
+
+    dims = dtw.getNumInputDimensions();
+    euclidean = DTWModel::metric(dtw) == DTW::EUCLIDEAN_DIST;
+    constrain = DTWModel::constrain(dtw);
+    radius = DTWModel::band(dtw);
+    mode = DTWModel::mode(dtw);
+    threshold = DTWModel::threshold(dtw);
+    useNullRejection = dtw.getNullRejectionEnabled();
+    thresholds = dtw.getNullRejectionThresholds();
+    all = likelihoods || (useNullRejection && mode != DTW::TEMPLATE_THRESHOLDS);
+
+    templates.resize(buffer.size());
+    for (size_t k=0; k<buffer.size(); k++) {
+      const MatrixFloat &m = buffer[k].timeSeries;
+      Template &t = templates[k];
+      t.label = buffer[k].classLabel;
+      t.rows = m.getNumRows();
+      t.cols = 0;
+      t.data.resize(t.rows * dims);
+      for (size_t i=0; i<t.rows; i++)
+        for (size_t j=0; j<dims; j++)
+          t.data[i*dims + j] = m[i][j];
+
+      t.lower.assign(dims, numeric_limits<Float>::infinity());
+      t.upper.assign(dims, -numeric_limits<Float>::infinity());
+      for (size_t i=0; i<t.rows; i++)
+        for (size_t j=0; j<dims; j++) {
+          t.lower[j] = min(t.lower[j], t.data[i*dims + j]);
+          t.upper[j] = max(t.upper[j], t.data[i*dims + j]);
+        }
+    }
+  }
+
+  bool predict(const MatrixFloat &x) {
+    if (x.getNumCols() != dims)
+      return false;
+
+    size_t N = x.getNumRows(), n = templates.size();
+    bool degenerate = N == 0 || n == 0;
+    for (auto &t : templates)
+      degenerate = degenerate || t.rows == 0;
+
+    if (degenerate) {
+      if (!fallback.predict(x))
+        return false;
+      predictedClassLabel = fallback.getPredictedClassLabel();
+      maxLikelihood = fallback.getMaximumLikelihood();
+      return true;
+    }
+
+    query.resize(N * dims);
+    for (size_t i=0; i<N; i++)
+      for (size_t j=0; j<dims; j++)
+        query[i*dims + j] = x[i][j];
+
+    size_t work = 0;
+    for (auto &t : templates) {
+      prepare(t, N);
+      work += t.cells * dims;
+    }
+
+    distances.assign(n, numeric_limits<Float>::quiet_NaN());
+    vector<size_t> order(n);
+    iota(order.begin(), order.end(), 0);
+
+    if (all || constrain)
+      each(order, work, [&](size_t k, Scratch &s) { distances[k] = exact(templates[k], s); });
+    else
+      search(order, work);
+
+    /* the closest template, the first one among equally close ones */
+    size_t closest = n;
+    for (size_t k=0; k<n; k++)
+      if (!std::isnan(distances[k]) && (closest == n || distances[k] < distances[closest]))
+        closest = k;
+
+    size_t likeliest = 0;
+    maxLikelihood = 0;
+    if (all) {
+      Float sum = 0;
+      likelihoods.resize(n);
+      for (size_t k=0; k<n; k++) {
+        likelihoods[k] = distances[k] > 1e-8 ? 1.0 / distances[k] : 1e8;
+        sum += likelihoods[k];
+      }
+      for (size_t k=0; k<n && sum > 0; k++)
+        if (likelihoods[k] / sum > maxLikelihood) {
+          maxLikelihood = likelihoods[k] / sum;
+          likeliest = k;
+        }
+    }
+
+    bool accepted = closest < thresholds.size() && distances[closest] <= thresholds[closest];
+    if (!useNullRejection)
+      predictedClassLabel = templates[closest].label;
+    else if (mode == DTW::TEMPLATE_THRESHOLDS)
+      predictedClassLabel = accepted ? templates[closest].label : GRT_DEFAULT_NULL_CLASS_LABEL;
+    else if (mode == DTW::CLASS_LIKELIHOODS)
+      predictedClassLabel = maxLikelihood >= threshold ? templates[likeliest].label : GRT_DEFAULT_NULL_CLASS_LABEL;
+    else
+      predictedClassLabel = accepted && maxLikelihood >= threshold ? templates[closest].label : GRT_DEFAULT_NULL_CLASS_LABEL;
+
+    return true;
+  }
+
+  protected:
+  /* A template with the warping band for the current query length: row i
+   * spans the columns [lo[i],hi[i]] and its cells are stored from base[i]
+   * on. The envelope holds the range of each dimension. */
+  struct Template {
+    UINT label;
+    size_t rows, cols, cells;
+    vector<Float> data, lower, upper, center;
+    vector<long> lo, hi;
+    vector<size_t> base;
+    Float kim, approx;
+  };
+
+  /* buffers of one thread */
+  struct Scratch {
+    vector<Float> cost, sum, length, matrix;
+    vector<char> visited;
+    vector<long> right, left;
+  };
+
+  size_t dims;
+  bool euclidean, constrain, useNullRejection, all;
+  Float radius, threshold;
+  UINT mode;
+  VectorFloat thresholds;
+  DTW &fallback;
+
+  vector<Template> templates;
+  vector<Float> query, distances, likelihoods;
+  atomic<Float> best;
+
+  static constexpr Float tolerance = 1e-9;
+
+  /* the local cost between template row i and query row j, summed like GRT */
+  Float cost(const Template &t, size_t i, size_t j) const {
+    const Float *a = &t.data[i*dims], *b = &query[j*dims];
+    Float d = 0;
+    if (euclidean) {
+      for (size_t k=0; k<dims; k++)
+        d += (a[k]-b[k]) * (a[k]-b[k]);
+      return sqrt(d);
+    }
+    for (size_t k=0; k<dims; k++)
+      d += fabs(a[k]-b[k]);
+    return d;
+  }
+
+  /* GRT's warping constraint, with the same arithmetic */
+  void prepare(Template &t, size_t N) {
+    long M = t.rows;
+    if (!constrain)
+      t.kim = cost(t, 0, 0) + (M+N > 2 ? cost(t, M-1, N-1) / (M+N-1) : 0);
+
+    if (t.cols == N)
+      return;
+
+    Float r = ceil(min<long>(M, N) * radius);
+    t.cols = N;
+    t.cells = 0;
+    t.lo.resize(M); t.hi.resize(M); t.base.resize(M); t.center.resize(M);
+
+    for (long i=0; i<M; i++) {
+      Float center = t.center[i] = (long(N)-1) / ((M-1) / Float(i));
+      auto in = [&](long j) { return !constrain || !(fabs(j - center) > r); };
+
+      long j = constrain && !std::isnan(center) ? max(0L, long(floor(center - r)) - 1) : 0;
+      while (j < long(N) && !in(j)) j++;
+      t.lo[i] = j;
+      while (j < long(N) && in(j)) j++;
+      t.hi[i] = j - 1;
+
+      t.base[i] = t.cells;
+      t.cells += max(0L, t.hi[i] - t.lo[i] + 1);
+    }
+  }
+
+  Float keogh(const Template &t) const {
+    size_t M = t.rows, N = t.cols;
+    Float bound = 0;
+
+    for (size_t j=0; j<N; j++) {
+      Float d = 0;
+      for (size_t k=0; k<dims; k++) {
+        Float v = query[j*dims + k],
+              e = v < t.lower[k] ? t.lower[k] - v : v > t.upper[k] ? v - t.upper[k] : 0;
+        d += euclidean ? e*e : e;
+      }
+      bound += (euclidean ? sqrt(d) : d) * (N - j);
+    }
+    return bound / (M+N-1);
+  }
+
+  bool exceeds(Float bound) const {
+    return bound > best.load() * (1 + tolerance);
+  }
+
+  void lower_best(Float d) {
+    Float current = best.load();
+    while (d < current && !best.compare_exchange_weak(current, d))
+      ;
+  }
+
+  /* prune and abandon, then compute the templates close to the best like GRT */
+  void search(vector<size_t> &order, size_t work) {
+    best = numeric_limits<Float>::infinity();
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return templates[a].kim < templates[b].kim; });
+
+    atomic<size_t> skipped(0);
+    each(order, work, [&](size_t k, Scratch &s) {
+      Template &t = templates[k];
+      t.approx = numeric_limits<Float>::infinity();
+      if (exceeds(t.kim) || exceeds(keogh(t)) || std::isinf(t.approx = forward(t, s)))
+        skipped++;
+      else
+        lower_best(t.approx);
+    });
+    pruned = skipped;
+
+    vector<size_t> candidates;
+    for (size_t k : order)
+      if (!(templates[k].approx > best.load() * (1 + tolerance)))
+        candidates.push_back(k);
+
+    each(candidates, 0, [&](size_t k, Scratch &s) { distances[k] = exact(templates[k], s); });
+  }
+
+  /* The forward pass over two rows. Each cell holds its cumulative cost,
+   * and the sum and length of the path GRT would trace back from it.
+   * Returns infinity once the template can not be closer than the best. */
+  Float forward(const Template &t, Scratch &s) {
+    size_t M = t.rows, N = t.cols;
+
+    s.cost.resize(2*N);
+    s.sum.resize(2*N);
+    s.length.resize(2*N);
+    Float *pc = &s.cost[0], *ps = &s.sum[0], *pl = &s.length[0],
+          *cc = &s.cost[N], *cs = &s.sum[N], *cl = &s.length[N];
+
+    for (size_t i=0; i<M; i++) {
+      Float prefix = numeric_limits<Float>::infinity();
+
+      for (size_t j=0; j<N; j++) {
+        Float local = cost(t, i, j), c = local, sum = 0, length = 0;
+
+        if (i == 0 && j > 0) {
+          c = local + cc[j-1]; sum = cs[j-1]; length = cl[j-1];
+        } else if (i > 0 && j == 0) {
+          c = local + pc[0]; sum = ps[0]; length = pl[0];
+        } else if (i > 0) {
+          /* diagonal, up, left, the first of equal ones wins */
+          Float v = pc[j-1]; sum = ps[j-1]; length = pl[j-1];
+          if (pc[j] < v)   { v = pc[j];   sum = ps[j];   length = pl[j];   }
+          if (cc[j-1] < v) { v = cc[j-1]; sum = cs[j-1]; length = cl[j-1]; }
+          c = local + v;
+        }
+
+        cc[j] = c;
+        cs[j] = sum + c;
+        cl[j] = length + 1;
+        prefix = min(prefix, cs[j] / cl[j]);
+      }
+
+      if (i+1 == M)
+        return cs[N-1] / cl[N-1];
+      if (exceeds(prefix))
+        return numeric_limits<Float>::infinity();
+
+      swap(pc, cc); swap(ps, cs); swap(pl, cl);
+    }
+    return numeric_limits<Float>::infinity();
+  }
+
+  /* GRT's distance. The cumulative costs are computed within the band,
+   * cells outside of it are unreachable (NaN). GRT's recursion marks the
+   * cells beyond an unreachable one, and leaves all others it did not visit
+   * at their local cost, which its trace back of the path may run into. */
+  Float exact(const Template &t, Scratch &s) {
+    long M = t.rows, N = t.cols;
+    const Float nan = numeric_limits<Float>::quiet_NaN(), max = numeric_limits<Float>::max();
+
+    s.matrix.resize(t.cells);
+    Float *m = s.matrix.empty() ? NULL : &s.matrix[0];
+    auto in = [&](long i, long j) { return j >= t.lo[i] && j <= t.hi[i]; };
+    auto at = [&](long i, long j) { return in(i, j) ? m[t.base[i] + j - t.lo[i]] : nan; };
+
+    for (long i=0; i<M; i++)
+      for (long j=t.lo[i]; j<=t.hi[i]; j++) {
+        Float local = cost(t, i, j), c;
+
+        if (i == 0 && j == 0)
+          c = local;
+        else if (i == 0)
+          c = local + at(0, j-1);
+        else if (j == 0)
+          c = local + at(i-1, 0);
+        else {
+          Float v = max, d = at(i-1, j-1), u = at(i-1, j), l = at(i, j-1);
+          int index = 0;
+          if (d < v) { v = d; index = 1; }
+          if (u < v) { v = u; index = 2; }
+          if (l < v) { v = l; index = 3; }
+          c = index ? local + v : 0;
+        }
+
+        m[t.base[i] + j - t.lo[i]] = c;
+      }
+
+    Float end = at(M-1, N-1);
+    if (std::isinf(end) || std::isnan(end))
+      return numeric_limits<Float>::infinity();
+
+    /* An unreachable cell right of the band marks the rows above it from
+     * its column on, one left of the band its own row and those below up
+     * to its column. Of row i only the columns [left[i],right[i]) are not
+     * marked. */
+    s.visited.assign(t.cells, !constrain);
+    s.right.assign(M, N);
+    s.left.assign(M, 0);
+
+    if (constrain) {
+      s.visited[t.base[M-1] + N-1 - t.lo[M-1]] = true;
+      auto visit = [&](long i, long j) {
+        if (in(i, j))
+          s.visited[t.base[i] + j - t.lo[i]] = true;
+        else if (j - t.center[i] > 0)
+          s.right[i] = min(s.right[i], j);
+        else
+          s.left[i] = std::max(s.left[i], j);
+      };
+
+      for (long i=M-1; i>=0; i--)
+        for (long j=t.hi[i]; j>=t.lo[i]; j--) {
+          if (!s.visited[t.base[i] + j - t.lo[i]] || (i == 0 && j == 0))
+            continue;
+          if (i > 0 && j > 0) visit(i-1, j-1);
+          if (i > 0)          visit(i-1, j);
+          if (j > 0)          visit(i, j-1);
+        }
+
+      for (long i=M-1, right=N; i>=0; i--) {
+        long own = s.right[i];
+        s.right[i] = right;
+        right = min(right, own);
+      }
+      for (long i=1; i<M; i++)
+        s.left[i] = std::max(s.left[i], s.left[i-1]);
+    }
+
+    auto value = [&](long i, long j) {
+      if (in(i, j) && s.visited[t.base[i] + j - t.lo[i]])
+        return fabs(at(i, j));
+      return j >= s.right[i] || j < s.left[i] ? nan : cost(t, i, j);
+    };
+
+    long i = M-1, j = N-1;
+    Float total = end, norm = 1;
+    while (i != 0 || j != 0) {
+      if (i == 0)
+        j--;
+      else if (j == 0)
+        i--;
+      else {
+        Float v = max, u = value(i-1, j), l = value(i, j-1);
+        int index = 0;
+        if (u < v)                { v = u; index = 1; }
+        if (l < v)                { v = l; index = 2; }
+        if (value(i-1, j-1) <= v) { index = 3; }
+
+        if (index == 0)
+          return numeric_limits<Float>::infinity();
+        if (index != 2) i--;
+        if (index != 1) j--;
+      }
+      norm++;
+      total += value(i, j);
+    }
+    return total / norm;
+  }
+
+  /* run func on all items, spread over a thread per core if there is enough work */
+  template<class F>
+  void each(const vector<size_t> &items, size_t work, F func) {
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+      Scratch s;
+      for (size_t i; (i = next++) < items.size(); )
+        func(items[i], s);
+    };
+
+    size_t threads = work < (1 << 16) ? 1 : min<size_t>(max(1u, thread::hardware_concurrency()), items.size());
+    vector<thread> workers;
+    for (size_t i=1; i<threads; i++)
+      workers.push_back(thread(worker));
+    worker();
+    for (auto &w : workers)
+      w.join();
+  }
+};
+
+/* Spots the templates of a DTW model in a continuous stream of samples with
+ * SPRING (Sakurai et al., Stream Monitoring under the Time Warping
+ * Distance, ICDE 2007). Every template keeps the last column of its
+ * subsequence DTW matrix, and where the best path into each of its cells
+ * started, so a sample costs O(template length) per template. The best
+ * match of a template is reported once no path in progress can overlap and
+ * improve it anymore.
+ *
+ * Distances are the DTW costs divided by the template length, so that one
+ * threshold fits templates of all lengths. GRT's warping constraint and the
+ * averaging over the warping path do not apply to subsequences. */
+class DtwSpotter {
+  public:
+  /* a match of a template over the samples [start,end) of the stream */
+  struct Detection {
+    UINT label;
+    size_t start, end;
+    Float distance;
+  };
+
+  static DtwSpotter *fromClassifier(Classifier *classifier, Float threshold) {
+    DTW *dtw = dynamic_cast<DTW*>(classifier);
+    if (dtw == NULL || !dtw->getTrained() || dtw->getScalingEnabled() || DTWModel::preprocess(*dtw))
+      return NULL;
+
+    UINT metric = DTWModel::metric(*dtw);
+    if (metric != DTW::EUCLIDEAN_DIST && metric != DTW::ABSOLUTE_DIST)
+      return NULL;
+
+    return new DtwSpotter(*dtw, threshold);
+  }
+
+  DtwSpotter(const DTW &dtw, Float threshold) : time(0) {
+    const Vector<DTWTemplate> &buffer = DTWModel::templates(dtw);
+    dims = dtw.getNumInputDimensions();
+    euclidean = DTWModel::metric(dtw) == DTW::EUCLIDEAN_DIST;
+
+    for (auto &b : buffer) {
+      const MatrixFloat &m = b.timeSeries;
+      if (m.getNumRows() == 0)
+        continue;
+
+      Template t;
+      t.label = b.classLabel;
+      t.rows = m.getNumRows();
+      t.threshold = threshold * t.rows;
+      t.data.resize(t.rows * dims);
+      for (size_t i=0; i<t.rows; i++)
+        for (size_t j=0; j<dims; j++)
+          t.data[i*dims + j] = m[i][j];
+      t.cost.assign(t.rows, numeric_limits<Float>::infinity());
+      t.start.assign(t.rows, 0);
+      t.best = numeric_limits<Float>::infinity();
+      templates.push_back(t);
+    }
+  }
+
+  /* feeds the next sample, matches confirmed by it are appended to found */
+  bool push(const VectorFloat &x, vector<Detection> &found) {
+    if (x.size() != dims)
+      return false;
+
+    for (auto &t : templates) {
+      /* the new column, a path may start at this sample in the first row */
+      Float left = 0, diag = 0;
+      size_t left_start = time, diag_start = time;
+
+      for (size_t i=0; i<t.rows; i++) {
+        Float up = t.cost[i], v = left;
+        size_t up_start = t.start[i], from = left_start;
+        if (up < v)   { v = up;   from = up_start; }
+        if (diag < v) { v = diag; from = diag_start; }
+
+        diag = up; diag_start = up_start;
+        left = t.cost[i] = cost(t, i, &x[0]) + v;
+        left_start = t.start[i] = from;
+      }
+
+      /* report the best match, once no path overlapping it can get closer */
+      if (t.best <= t.threshold) {
+        bool done = true;
+        for (size_t i=0; i<t.rows && done; i++)
+          done = t.cost[i] >= t.best || t.start[i] > t.to;
+
+        if (done) {
+          found.push_back(Detection{t.label, t.from, t.to + 1, t.best / t.rows});
+          for (size_t i=0; i<t.rows; i++)
+            if (t.start[i] <= t.to)
+              t.cost[i] = numeric_limits<Float>::infinity();
+          t.best = numeric_limits<Float>::infinity();
+        }
+      }
+
+      Float last = t.cost[t.rows-1];
+      if (last <= t.threshold && last < t.best) {
+        t.best = last;
+        t.from = t.start[t.rows-1];
+        t.to = time;
+      }
+    }
+
+    time++;
+    return true;
+  }
+
+  /* the end of the stream, the pending matches are appended to found */
+  void finish(vector<Detection> &found) {
+    for (auto &t : templates) {
+      if (t.best <= t.threshold)
+        found.push_back(Detection{t.label, t.from, t.to + 1, t.best / t.rows});
+      t.best = numeric_limits<Float>::infinity();
+      t.cost.assign(t.rows, numeric_limits<Float>::infinity());
+    }
+  }
+
+  protected:
+  /* the last column of the template's matrix, the current best match
+   * [from,to] and the threshold on its undivided cost */
+  struct Template {
+    UINT label;
+    size_t rows, from, to;
+    vector<Float> data, cost;
+    vector<size_t> start;
+    Float threshold, best;
+  };
+
+  size_t dims, time;
+  bool euclidean;
+  vector<Template> templates;
+
+  Float cost(const Template &t, size_t i, const Float *b) const {
+    const Float *a = &t.data[i*dims];
+    Float d = 0;
+    if (euclidean) {
+      for (size_t k=0; k<dims; k++)
+        d += (a[k]-b[k]) * (a[k]-b[k]);
+      return sqrt(d);
+    }
+    for (size_t k=0; k<dims; k++)
+      d += fabs(a[k]-b[k]);
+    return d;
+  }
+};
+
+#endif
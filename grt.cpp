@@ -18,6 +18,8 @@ vector<vector<const char*>> cmds = {
   {"extract",     "e",   "extract features from a data sequence"},
   {"preprocess",  "pp",  "preprocess data sequence"},
   {"postprocess", "pop", "postprocess label streams"},
+  {"pipeline",    "pi",  "predict, postprocess and score in one process"},
+  {"compile",     "c",   "compile tree-based models to a shared library for predict"},
   {"plot",        "pl",  "python based stream plotter"},
   {"montage",     "m",   "python based montage plot"},
   {"segment",     "sg",  "segments a list of samples into multiple timeseries"},
@@ -0,0 +1,448 @@
+#ifndef _HMM_H_
+#define _HMM_H_
+
+#include <GRT.h>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+using namespace GRT;
+using namespace std;
+
+/* GRT's HMM keeps its class models protected, and the models their
+ * parameters, pointers to the members taken through derived classes give
+ * read access to them. */
+struct HMMModels : public HMM {
+  static UINT type(const HMM &h)      { return h.*(&HMMModels::hmmType); }
+  static UINT symbols(const HMM &h)   { return h.*(&HMMModels::numSymbols); }
+  static UINT committee(const HMM &h) { return h.*(&HMMModels::committeeSize); }
+  static const Vector<DiscreteHiddenMarkovModel> &discrete(const HMM &h)     { return h.*(&HMMModels::discreteModels); }
+  static const Vector<ContinuousHiddenMarkovModel> &continuous(const HMM &h) { return h.*(&HMMModels::continuousModels); }
+};
+
+struct DiscreteHMMParameters : public DiscreteHiddenMarkovModel {
+  static UINT states(const DiscreteHiddenMarkovModel &m)              { return m.*(&DiscreteHMMParameters::numStates); }
+  static const MatrixFloat &A(const DiscreteHiddenMarkovModel &m)     { return m.*(&DiscreteHMMParameters::a); }
+  static const MatrixFloat &B(const DiscreteHiddenMarkovModel &m)     { return m.*(&DiscreteHMMParameters::b); }
+  static const VectorFloat &prior(const DiscreteHiddenMarkovModel &m) { return m.*(&DiscreteHMMParameters::pi); }
+};
+
+struct ContinuousHMMParameters : public ContinuousHiddenMarkovModel {
+  static UINT states(const ContinuousHiddenMarkovModel &m)              { return m.*(&ContinuousHMMParameters::numStates); }
+  static UINT dimensions(const ContinuousHiddenMarkovModel &m)          { return m.*(&ContinuousHMMParameters::numInputDimensions); }
+  static UINT downsample(const ContinuousHiddenMarkovModel &m)          { return m.*(&ContinuousHMMParameters::downsampleFactor); }
+  static UINT label(const ContinuousHiddenMarkovModel &m)               { return m.*(&ContinuousHMMParameters::classLabel); }
+  static const MatrixFloat &A(const ContinuousHiddenMarkovModel &m)     { return m.*(&ContinuousHMMParameters::a); }
+  static const MatrixFloat &means(const ContinuousHiddenMarkovModel &m) { return m.*(&ContinuousHMMParameters::b); }
+  static const MatrixFloat &sigma(const ContinuousHiddenMarkovModel &m) { return m.*(&ContinuousHMMParameters::sigmaStates); }
+  static const VectorFloat &prior(const ContinuousHiddenMarkovModel &m) { return m.*(&ContinuousHMMParameters::pi); }
+};
+
+/* Replaces GRT's evaluation of HMMs, which runs the forward algorithm of
+ * each class model separately, allocating its variables on every
+ * prediction. Here all models advance together, one frame at a time, on
+ * buffers that are kept across predictions. The transition matrices are
+ * stored by row and the discrete emissions by symbol, so that the update of
+ * all states reads contiguous memory and vectorizes, while each state still
+ * sums over its predecessors in GRT's order. The forward variables are
+ * scaled to one per frame and the log of the scaling factors summed, like
+ * GRT does, and predictions stay identical.
+ *
+ * Continuous HMMs hold one model per training sample. Their gaussian
+ * emissions are evaluated like GRT's, with the normalization and the
+ * variance of each state precomputed, on frames averaged over blocks of the
+ * downsample factor, if the timeseries is longer than that. The models are
+ * then ranked by their log-likelihood and the best of the committee vote
+ * for their class, like GRT does. Continuous models with null rejection are
+ * left to GRT (fromClassifier returns NULL).
+ *
+ * Frames can also be pushed one by one, classify() then predicts the
+ * frames since the last reset as predict() would, without going over the
+ * earlier frames again. */
+class HmmForward {
+  public:
+  UINT predictedClassLabel;
+  Float maxLikelihood;
+
+  static HmmForward *fromClassifier(Classifier *classifier) {
+    HMM *hmm = dynamic_cast<HMM*>(classifier);
+    if (hmm == NULL || !hmm->getTrained())
+      return NULL;
+
+    if (HMMModels::type(*hmm) == HMM_DISCRETE)
+      return new HmmForward(*hmm);
+
+    /* all models downsample alike, so that they advance by the same blocks */
+    const Vector<ContinuousHiddenMarkovModel> &continuous = HMMModels::continuous(*hmm);
+    if (HMMModels::type(*hmm) != HMM_CONTINUOUS || hmm->getNullRejectionEnabled() || continuous.size() == 0)
+      return NULL;
+    for (auto &m : continuous)
+      if (ContinuousHMMParameters::downsample(m) == 0 ||
+          ContinuousHMMParameters::downsample(m) != ContinuousHMMParameters::downsample(continuous[0]) ||
+          ContinuousHMMParameters::dimensions(m) != hmm->getNumInputDimensions())
+        return NULL;
+
+    return new HmmForward(*hmm);
+  }
+
+  HmmForward(HMM &hmm)
+    : predictedClassLabel(0), maxLikelihood(0), fallback(hmm), scaling(false), numSymbols(0), downsample(1), committee(0)
+  {
+    continuous = HMMModels::type(hmm) == HMM_CONTINUOUS;
+    classLabels = hmm.getClassLabels();
+    useNullRejection = hmm.getNullRejectionEnabled();
+    thresholds = hmm.getNullRejectionThresholds();
+
+    size_t offset = 0, widest = 0;
+    if (continuous) {
+      const Vector<ContinuousHiddenMarkovModel> &trained = HMMModels::continuous(hmm);
+      dims = hmm.getNumInputDimensions();
+      downsample = ContinuousHMMParameters::downsample(trained[0]);
+      committee = min((size_t) HMMModels::committee(hmm), (size_t) trained.size());
+      scaling = hmm.getScalingEnabled();
+      ranges = hmm.getRanges();
+
+      for (auto &m : trained) {
+        const MatrixFloat &means = ContinuousHMMParameters::means(m), &sigma = ContinuousHMMParameters::sigma(m);
+        Model model = parameters(ContinuousHMMParameters::states(m), ContinuousHMMParameters::A(m), ContinuousHMMParameters::prior(m), offset);
+        model.label = ContinuousHMMParameters::label(m);
+
+        /* GRT's gauss() computes 1/(sigma*sqrt(2pi)) * exp(-(mean-x)^2/(2*sigma^2)) per dimension */
+        for (size_t i=0; i<model.states; i++)
+          for (size_t n=0; n<dims; n++) {
+            model.means.push_back(means[i][n]);
+            model.norms.push_back(1.0/(sigma[i][n] * SQRT_TWO_PI));
+            model.variances.push_back(2.0*(sigma[i][n]*sigma[i][n]));
+          }
+
+        offset += model.states;
+        widest = max(widest, model.states);
+        models.push_back(model);
+      }
+    } else {
+      const Vector<DiscreteHiddenMarkovModel> &trained = HMMModels::discrete(hmm);
+      dims = 1;
+      numSymbols = HMMModels::symbols(hmm);
+
+      for (auto &m : trained) {
+        const MatrixFloat &B = DiscreteHMMParameters::B(m);
+        Model model = parameters(DiscreteHMMParameters::states(m), DiscreteHMMParameters::A(m), DiscreteHMMParameters::prior(m), offset);
+
+        model.emissions.resize(numSymbols * model.states);
+        for (size_t s=0; s<numSymbols; s++)
+          for (size_t j=0; j<model.states; j++)
+            model.emissions[s*model.states + j] = B[j][s];
+
+        offset += model.states;
+        widest = max(widest, model.states);
+        models.push_back(model);
+      }
+    }
+
+    alpha.resize(offset);
+    scratch.resize(offset);
+    next.resize(widest);
+    emission.resize(widest);
+    loglikelihoods.resize(models.size());
+    scores.resize(models.size());
+    reset();
+  }
+
+  /* a whole timeseries, one frame per row */
+  bool predict(const MatrixFloat &x) {
+    if (x.getNumCols() != dims)
+      return false;
+
+    if (x.getNumRows() == 0)
+      return grt(x);
+
+    if (!continuous)
+      for (size_t t=0; t<x.getNumRows(); t++)
+        if ((UINT) x[t][0] >= numSymbols)
+          return false;
+
+    reset();
+    for (size_t t=0; t<x.getNumRows(); t++)
+      if (!push(x[t]))
+        return false;
+
+    if (continuous)
+      return vote() || grt(x);
+    return classify();
+  }
+
+  /* start a new timeseries */
+  void reset() {
+    frames = blocks = 0;
+    block.clear();
+    head.clear();
+    fill(loglikelihoods.begin(), loglikelihoods.end(), 0);
+  }
+
+  /* append a frame to the timeseries, a symbol for discrete models */
+  bool push(const VectorFloat &frame) {
+    return frame.size() == dims && push(&frame[0]);
+  }
+
+  /* the prediction on the frames pushed since the last reset */
+  bool classify() {
+    if (frames == 0 || models.size() == 0)
+      return false;
+
+    if (continuous) {
+      if (!vote()) {
+        predictedClassLabel = GRT_DEFAULT_NULL_CLASS_LABEL;
+        maxLikelihood = 0;
+      }
+      return true;
+    }
+
+    if (models.size() > classLabels.size())
+      return false;
+
+    /* the log-likelihoods are negative, the one closest to 0 wins */
+    Float best = -99e+99, sum = 0;
+    size_t bestIndex = 0;
+    for (size_t k=0; k<models.size(); k++) {
+      Float distance = -loglikelihoods[k];
+      if (distance > best) {
+        best = distance;
+        bestIndex = k;
+      }
+      sum += exp(distance);
+    }
+
+    maxLikelihood = exp(-loglikelihoods[bestIndex]) / sum;
+    predictedClassLabel = classLabels[bestIndex];
+
+    if (useNullRejection && bestIndex < thresholds.size() && !(maxLikelihood > thresholds[bestIndex]))
+      predictedClassLabel = GRT_DEFAULT_NULL_CLASS_LABEL;
+
+    return true;
+  }
+
+  protected:
+  bool grt(const MatrixFloat &x) {
+    if (!fallback.predict(x))
+      return false;
+    predictedClassLabel = fallback.getPredictedClassLabel();
+    maxLikelihood = fallback.getMaximumLikelihood();
+    return true;
+  }
+
+  bool push(const Float *frame) {
+    if (!continuous) {
+      UINT symbol = (UINT) frame[0];
+      if (symbol >= numSymbols)
+        return false;
+
+      for (size_t k=0; k<models.size(); k++) {
+        const Model &m = models[k];
+        loglikelihoods[k] += step(m, &m.emissions[symbol * m.states], &alpha[m.offset], &alpha[m.offset], frames == 0);
+      }
+      frames++;
+      return true;
+    }
+
+    /* (x-min)*(1-0)/(max-min)+0 is what GRT computes, without the identities */
+    for (size_t n=0; n<dims; n++)
+      block.push_back(!scaling ? frame[n] : ranges[n].minValue == ranges[n].maxValue ? 0 :
+                      (frame[n] - ranges[n].minValue) / (ranges[n].maxValue - ranges[n].minValue));
+    frames++;
+
+    /* a full block is averaged into one observation and kept, the frames
+     * of the first one are needed as long as the timeseries is no longer */
+    if (block.size() == downsample * dims) {
+      average(block, obs);
+      for (size_t k=0; k<models.size(); k++) {
+        const Model &m = models[k];
+        gauss(m, &obs[0]);
+        loglikelihoods[k] += step(m, &emission[0], &alpha[m.offset], &alpha[m.offset], blocks == 0);
+      }
+      if (blocks == 0)
+        head.swap(block);
+      block.clear();
+      blocks++;
+    }
+
+    return true;
+  }
+
+  /* the parameters of one model, its forward variables are stored in alpha
+   * from offset on */
+  struct Model {
+    size_t states, offset;
+    UINT label;
+    vector<Float> prior, transitions, emissions, means, norms, variances;
+  };
+
+  static Model parameters(size_t states, const MatrixFloat &A, const VectorFloat &prior, size_t offset) {
+    Model model;
+    model.states = states;
+    model.offset = offset;
+    model.label = 0;
+    model.prior.assign(prior.begin(), prior.end());
+
+    model.transitions.resize(states * states);
+    for (size_t i=0; i<states; i++)
+      for (size_t j=0; j<states; j++)
+        model.transitions[i*states + j] = A[i][j];
+    return model;
+  }
+
+  /* advance the forward variables of a model by one observation with the
+   * given emission probabilities, from may be to. returns the log of the
+   * scaling factor */
+  Float step(const Model &m, const Float *b, const Float *from, Float *to, bool first) {
+    const size_t N = m.states;
+    Float c = 0;
+
+    if (first)
+      for (size_t i=0; i<N; i++)
+        next[i] = m.prior[i] * b[i];
+    else {
+      fill(next.begin(), next.begin() + N, 0);
+      for (size_t i=0; i<N; i++) {
+        const Float x = from[i], *row = &m.transitions[i*N];
+        for (size_t j=0; j<N; j++)
+          next[j] += x * row[j];
+      }
+      for (size_t j=0; j<N; j++)
+        next[j] *= b[j];
+    }
+
+    for (size_t j=0; j<N; j++)
+      c += next[j];
+    c = 1.0 / c;
+
+    for (size_t j=0; j<N; j++)
+      to[j] = next[j] * c;
+    return log(c);
+  }
+
+  /* the emission probability of each state of a continuous model */
+  void gauss(const Model &m, const Float *x) {
+    for (size_t i=0; i<m.states; i++) {
+      const Float *mean = &m.means[i*dims], *norm = &m.norms[i*dims], *variance = &m.variances[i*dims];
+      Float z = 1;
+      for (size_t n=0; n<dims; n++)
+        z *= norm[n] * exp(-((mean[n] - x[n])*(mean[n] - x[n])) / variance[n]);
+      emission[i] = z;
+    }
+  }
+
+  /* the mean of the frames in order, as GRT downsamples */
+  void average(const vector<Float> &values, vector<Float> &out) {
+    size_t count = values.size() / dims;
+    out.assign(dims, 0);
+    for (size_t n=0; n<dims; n++) {
+      for (size_t f=0; f<count; f++)
+        out[n] += values[f*dims + n];
+      if (count > 1)
+        out[n] /= count;
+    }
+  }
+
+  /* the log-likelihood of each continuous model. GRT only downsamples
+   * timeseries longer than the factor, shorter ones are scored frame by
+   * frame. otherwise a block that is not yet full is averaged as it is,
+   * and scored on a copy of the forward variables. */
+  void score() {
+    if (frames <= downsample) {
+      const vector<Float> &raw = blocks == 0 ? block : head;
+      for (size_t k=0; k<models.size(); k++) {
+        const Model &m = models[k];
+        Float sum = 0;
+        for (size_t t=0; t<frames; t++) {
+          gauss(m, &raw[t*dims]);
+          sum += step(m, &emission[0], &scratch[m.offset], &scratch[m.offset], t == 0);
+        }
+        scores[k] = -sum;
+      }
+      return;
+    }
+
+    if (block.size() > 0)
+      average(block, obs);
+
+    for (size_t k=0; k<models.size(); k++) {
+      const Model &m = models[k];
+      Float sum = loglikelihoods[k];
+      if (block.size() > 0) {
+        gauss(m, &obs[0]);
+        sum += step(m, &emission[0], &alpha[m.offset], &scratch[m.offset], false);
+      }
+      scores[k] = -sum;
+    }
+  }
+
+  /* GRT's committee: the best models each add their log-likelihood,
+   * scaled from [-1000,0], to their class. if no class gets more than the
+   * best log-likelihood, GRT takes the index of the best model for the one
+   * of the class, which is only defined if there are that many classes.
+   * returns false otherwise, predict() then leaves it to GRT and the
+   * incremental prediction is the NULL class. */
+  bool vote() {
+    score();
+
+    Float bestDistance = -1000;
+    size_t bestIndex = 0;
+    Vector<IndexedDouble> results(models.size());
+    for (size_t k=0; k<models.size(); k++) {
+      results[k].value = scores[k];
+      results[k].index = models[k].label;
+      if (scores[k] > bestDistance && !std::isnan(scores[k])) {
+        bestDistance = scores[k];
+        bestIndex = k;
+      }
+    }
+
+    std::sort(results.begin(), results.end(), IndexedDouble::sortIndexedDoubleByValueDescending);
+
+    VectorFloat distances(classLabels.size(), 0);
+    for (size_t i=0; i<committee; i++)
+      distances[fallback.getClassLabelIndexValue(results[i].index)] +=
+        Util::scale(results[i].value, -1000, 0, 0, DEFAULT_NULL_LIKELIHOOD_VALUE, true);
+
+    Float sum = 0;
+    for (size_t k=0; k<distances.size(); k++)
+      sum += distances[k];
+
+    if (!(sum > 0)) {
+      maxLikelihood = 0;
+      predictedClassLabel = 0;
+      return true;
+    }
+
+    for (size_t k=0; k<distances.size(); k++)
+      if (distances[k] > bestDistance) {
+        bestDistance = distances[k];
+        bestIndex = k;
+      }
+
+    if (bestIndex >= classLabels.size())
+      return false;
+
+    maxLikelihood = distances[bestIndex] / sum;
+    predictedClassLabel = classLabels[bestIndex];
+    return true;
+  }
+
+  HMM &fallback;
+  bool continuous, useNullRejection, scaling;
+  UINT numSymbols;
+  size_t dims, downsample, committee;
+  Vector<UINT> classLabels;
+  VectorFloat thresholds;
+  Vector<MinMax> ranges;
+
+  vector<Model> models;
+  vector<Float> alpha, scratch, next, emission, loglikelihoods, scores;
+
+  /* the incremental state: frames pushed, full blocks scored, the frames of
+   * the block being filled and of the first one, and the last average */
+  size_t frames, blocks;
+  vector<Float> block, head, obs;
+};
+
+#endif
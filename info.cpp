@@ -23,17 +23,22 @@ int main(int argc, char *argv[])
   /* handling of TERM and INT signal and set verbosity */
   set_verbosity(c.get<int>("verbose"));
 
-  /* load the dataset and print its stats */
-  istream &in = grt_fileinput(c);
-  if (!in) return -1;
+  /* only the stats are accumulated while reading, the dataset itself is never kept */
+  vector<string> files = c.rest();
+  if (files.size() == 0)
+    files.push_back("-");
 
   string type = c.get<string>("type");
   CsvIOSample io(type);
-  CollectDataset dataset;
+  DatasetStats stats;
 
-  while (in >> io)
-    csvio_dispatch(io, dataset.add, io.labelset);
+  bool ok = csvio_files(files, io, [&](CsvIOSample &io, const string &filename) {
+    csvio_dispatch(io, stats.add, io.labelset);
+    return true;
+  });
 
-  cout << dataset.getStatsAsString();
+  if (!ok) return -1;
+
+  cout << stats.getStatsAsString();
   return 0;
 }
@@ -0,0 +1,303 @@
+#ifndef _KNN_H_
+#define _KNN_H_
+
+#include <GRT.h>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+
+using namespace GRT;
+using namespace std;
+
+/* GRT's KNN keeps its training data protected, a pointer to the member
+ * taken through a derived class gives read access to it. */
+struct KNNTrainingData : public KNN {
+  static const ClassificationData &of(const KNN &knn) {
+    return knn.*(&KNNTrainingData::trainingData);
+  }
+};
+
+/* Distances between two contiguous rows. They are summed in four
+ * independent lanes, which the compiler vectorizes without having to
+ * reorder a single running sum. */
+static inline Float knn_sqeuclidean(const Float *a, const Float *b, size_t n) {
+  Float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  size_t j = 0;
+  for (; j+4 <= n; j += 4) {
+    Float d0 = a[j]-b[j], d1 = a[j+1]-b[j+1], d2 = a[j+2]-b[j+2], d3 = a[j+3]-b[j+3];
+    s0 += d0*d0; s1 += d1*d1; s2 += d2*d2; s3 += d3*d3;
+  }
+  for (; j < n; j++)
+    s0 += (a[j]-b[j]) * (a[j]-b[j]);
+  return (s0 + s1) + (s2 + s3);
+}
+
+static inline Float knn_manhattan(const Float *a, const Float *b, size_t n) {
+  Float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  size_t j = 0;
+  for (; j+4 <= n; j += 4) {
+    s0 += fabs(a[j]-b[j]);     s1 += fabs(a[j+1]-b[j+1]);
+    s2 += fabs(a[j+2]-b[j+2]); s3 += fabs(a[j+3]-b[j+3]);
+  }
+  for (; j < n; j++)
+    s0 += fabs(a[j]-b[j]);
+  return (s0 + s1) + (s2 + s3);
+}
+
+/* Replaces GRT's linear scan over all training samples of a KNN model with
+ * a kd-tree search. The K nearest neighbours are voted on like GRT does,
+ * including the NULL-class rejection on the mean distance of the winning
+ * class. Which of several neighbours at the same distance GRT keeps depends
+ * on the order of its scan, so when neighbours with different labels are
+ * tied at the K-th distance the prediction is left to GRT, and results
+ * stay identical.
+ *
+ * With eps > 0 the search is (1+eps)-approximate: subtrees are skipped
+ * unless they may hold a neighbour closer than the current K-th one by a
+ * factor of 1+eps, trading recall for speed. Ties are not checked then.
+ *
+ * Only euclidean and manhattan distances are indexed, models with cosine
+ * distance or scaling are left to GRT (fromClassifier returns NULL). */
+class KnnIndex {
+  public:
+  UINT predictedClassLabel;
+  Float maxLikelihood;
+  size_t ties; // number of predictions left to GRT because of tied neighbours
+
+  static KnnIndex *fromClassifier(Classifier *classifier, Float eps) {
+    KNN *knn = dynamic_cast<KNN*>(classifier);
+    if (knn == NULL || !knn->getTrained() || knn->getScalingEnabled())
+      return NULL;
+
+    UINT metric = knn->getDistanceMethod();
+    if (metric != KNN::EUCLIDEAN_DISTANCE && metric != KNN::MANHATTAN_DISTANCE)
+      return NULL;
+
+    return new KnnIndex(KNNTrainingData::of(*knn), knn->getK(), metric, eps, knn->getClassLabels(),
+                        knn->getNullRejectionEnabled(), knn->getNullRejectionThresholds(), knn);
+  }
+
+  KnnIndex(const ClassificationData &data, UINT k, UINT metric, Float eps, const Vector<UINT> &classLabels,
+           bool nullRejection, const VectorFloat &thresholds, KNN *fallback = NULL)
+    : predictedClassLabel(0), maxLikelihood(0), ties(0), K(k), metric(metric), classLabels(classLabels),
+      useNullRejection(nullRejection), thresholds(thresholds), fallback(fallback)
+  {
+    size_t n = data.getNumSamples();
+    dims = data.getNumDimensions();
+
+    /* votes are counted by class index, the labels may have gaps when a
+     * class is missing from the training data */
+    for (size_t k=0; k<classLabels.size(); k++) {
+      if (classLabels[k] >= indices.size()) indices.resize(classLabels[k]+1, -1);
+      indices[classLabels[k]] = k;
+    }
+
+    /* search distances are squared for euclidean, so is the pruning scale */
+    scale = metric == KNN::EUCLIDEAN_DISTANCE ? (1+eps)*(1+eps) : 1+eps;
+    exact_search = eps <= 0;
+
+    vector<Float> samples(n * dims);
+    labels.resize(n);
+    for (size_t i=0; i<n; i++) {
+      const VectorFloat &x = data[i].getSample();
+      copy(x.begin(), x.end(), samples.begin() + i*dims);
+      labels[i] = data[i].getClassLabel();
+    }
+
+    /* rows are stored in tree order, so that leaves are contiguous */
+    order.resize(n);
+    for (size_t i=0; i<n; i++) order[i] = i;
+    if (n > 0) build(0, n, samples);
+
+    points.resize(n * dims);
+    rows.resize(n);
+    for (size_t r=0; r<n; r++) {
+      copy(samples.begin() + order[r]*dims, samples.begin() + (order[r]+1)*dims, points.begin() + r*dims);
+      rows[order[r]] = r;
+    }
+  }
+
+  bool predict(const VectorFloat &x) {
+    if (x.size() != dims || nodes.size() == 0 || K == 0)
+      return false;
+
+    /* An exact search fetches neighbours until one is clearly further away
+     * than the K-th, so that all candidates tied with it are known. The
+     * search distances are summed differently than GRT's, a relative
+     * difference in the order of rounding errors counts as a tie. */
+    search_k = exact_search ? K + 1 : K;
+    for (;;) {
+      heap.clear();
+      search(0, &x[0]);
+      sort_heap(heap.begin(), heap.end());
+
+      if (heap.size() < search_k || !exact_search || heap.back().first - heap[K-1].first > 1e-9 * heap.back().first)
+        break;
+      search_k *= 2;
+    }
+
+    /* the candidates are ranked by their distance as GRT computes it */
+    for (auto &neighbour : heap)
+      neighbour.first = exact(&x[0], &points[rows[neighbour.second] * dims]);
+    sort(heap.begin(), heap.end());
+
+    /* GRT keeps the neighbours tied at the K-th distance in the order of its
+     * scan, only if they all share one label it does not matter which */
+    if (heap.size() > K && heap[K].first == heap[K-1].first) {
+      bool same = true;
+      for (size_t i=0; i<heap.size() && same; i++)
+        same = heap[i].first != heap[K-1].first || labels[heap[i].second] == labels[heap[K-1].second];
+
+      if (!same && fallback != NULL) {
+        ties++;
+        if (!fallback->predict(x))
+          return false;
+        predictedClassLabel = fallback->getPredictedClassLabel();
+        maxLikelihood = fallback->getMaximumLikelihood();
+        return true;
+      }
+    }
+
+    heap.resize(min(heap.size(), K));
+
+    /* count the classes among the K nearest */
+    size_t numClasses = classLabels.size();
+    votes.assign(numClasses, 0);
+    distances.assign(numClasses, 0);
+
+    for (auto &neighbour : heap) {
+      UINT label = labels[neighbour.second];
+      if (label >= indices.size() || indices[label] < 0)
+        return false;
+
+      votes[indices[label]]++;
+      distances[indices[label]] += neighbour.first;
+    }
+
+    size_t maxIndex = 0;
+    for (size_t i=1; i<numClasses; i++)
+      if (votes[i] > votes[maxIndex])
+        maxIndex = i;
+
+    /* the winning class is rejected if its neighbours are too far off on average */
+    bool rejected = useNullRejection && maxIndex < thresholds.size() &&
+                    distances[maxIndex] / votes[maxIndex] > thresholds[maxIndex];
+
+    maxLikelihood = votes[maxIndex] / Float(heap.size());
+    predictedClassLabel = rejected ? GRT_DEFAULT_NULL_CLASS_LABEL : classLabels[maxIndex];
+    return true;
+  }
+
+  protected:
+  /* inner nodes split at a value of one dimension, leaves hold [begin,end) */
+  struct Node {
+    size_t begin, end, left, right, dim;
+    Float split;
+  };
+
+  static const size_t leaf_size = 16;
+
+  size_t dims, K, search_k;
+  UINT metric;
+  Float scale;
+  bool exact_search;
+  Vector<UINT> classLabels;
+  bool useNullRejection;
+  VectorFloat thresholds;
+  KNN *fallback;
+
+  vector<Float> points;
+  vector<size_t> order, rows; // sample index of each row, and row of each sample
+  vector<UINT> labels;        // class label of each sample
+  vector<int> indices;        // index into classLabels of each label, -1 if none
+  vector<Node> nodes;
+
+  /* the K nearest so far, a max-heap on (distance, sample index) */
+  vector< pair<Float,size_t> > heap;
+  VectorFloat votes, distances;
+
+  size_t build(size_t begin, size_t end, const vector<Float> &samples) {
+    size_t id = nodes.size();
+    nodes.push_back(Node{begin, end, 0, 0, 0, 0});
+
+    if (end - begin <= leaf_size)
+      return id;
+
+    /* split the dimension with the largest spread at its median */
+    size_t dim = 0;
+    Float spread = 0;
+    for (size_t j=0; j<dims; j++) {
+      Float lo = samples[order[begin]*dims + j], hi = lo;
+      for (size_t i=begin+1; i<end; i++) {
+        Float v = samples[order[i]*dims + j];
+        lo = min(lo, v);
+        hi = max(hi, v);
+      }
+      if (hi - lo > spread) {
+        spread = hi - lo;
+        dim = j;
+      }
+    }
+
+    if (spread == 0)
+      return id;
+
+    size_t mid = begin + (end - begin) / 2;
+    nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                [&](size_t a, size_t b) { return samples[a*dims + dim] < samples[b*dims + dim]; });
+
+    Float split = samples[order[mid]*dims + dim];
+    size_t left = build(begin, mid, samples), right = build(mid, end, samples);
+
+    nodes[id].dim = dim;
+    nodes[id].split = split;
+    nodes[id].left = left;
+    nodes[id].right = right;
+    return id;
+  }
+
+  /* the root is node 0, so 0 never is a child */
+  void search(size_t id, const Float *x) {
+    const Node &node = nodes[id];
+
+    if (node.left == 0) {
+      for (size_t r=node.begin; r<node.end; r++)
+        consider(distance(x, &points[r*dims]), order[r]);
+      return;
+    }
+
+    Float diff = x[node.dim] - node.split;
+    search(diff <= 0 ? node.left : node.right, x);
+
+    Float bound = metric == KNN::EUCLIDEAN_DISTANCE ? diff*diff : fabs(diff);
+    if (heap.size() < search_k || bound * scale <= heap.front().first)
+      search(diff <= 0 ? node.right : node.left, x);
+  }
+
+  void consider(Float dist, size_t sample) {
+    pair<Float,size_t> candidate(dist, sample);
+
+    if (heap.size() < search_k) {
+      heap.push_back(candidate);
+      push_heap(heap.begin(), heap.end());
+    } else if (candidate < heap.front()) {
+      pop_heap(heap.begin(), heap.end());
+      heap.back() = candidate;
+      push_heap(heap.begin(), heap.end());
+    }
+  }
+
+  Float distance(const Float *a, const Float *b) {
+    return metric == KNN::EUCLIDEAN_DISTANCE ? knn_sqeuclidean(a, b, dims) : knn_manhattan(a, b, dims);
+  }
+
+  Float exact(const Float *a, const Float *b) {
+    Float dist = 0;
+    for (size_t j=0; j<dims; j++)
+      dist += metric == KNN::EUCLIDEAN_DISTANCE ? (a[j]-b[j]) * (a[j]-b[j]) : fabs(a[j]-b[j]);
+    return metric == KNN::EUCLIDEAN_DISTANCE ? sqrt(dist) : dist;
+  }
+};
+
+#endif
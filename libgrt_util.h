@@ -7,7 +7,11 @@
 #include <climits>
 #include <locale> // for isspace
 #include <string>
+#include <map>
+#include <memory>
+#include <thread>
 #include <unistd.h>
+#include <sys/stat.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <signal.h>
@@ -71,20 +75,26 @@ class CsvIOSample {
       return i;
     }
 
+    /* All rows of a sample are parsed into one contiguous buffer, which keeps
+     * its capacity from sample to sample. The sample is then built from it
+     * with one copy, instead of allocating every row on its own. */
     friend std::istream& operator>> (std::istream &in, CsvIOSample &o) 
     {
       using namespace std;
 
-      string line, label;
-      Vector<VectorFloat> data;
-      double d;
+      const char *ws = " \t\r\n\v\f";
+      string &line = o.line, label;
+      VectorFloat &values = o.values;
+      size_t rows = 0, cols = 0;
+      bool ragged = false;
+
+      values.clear();
 
       while (getline(in,line)) {
-        stringstream ss(line);
         o.linenum++;
 
         if (line.find_first_not_of(" \t") == string::npos) {
-          if (data.size()!=0)
+          if (rows!=0)
             break;
           else
             continue;
@@ -98,37 +108,48 @@ class CsvIOSample {
         if (o.type==UNKNOWN)
           o.type = CLASSIFICATION; // default to classificaion
 
-        ss >> label;
-        VectorFloat sample;
-        string val;
-        while (ss >> val) // this also handles nan and infs correctly
-          sample.push_back(strtod(val.c_str(),NULL));
+        size_t b = line.find_first_not_of(ws), e, n = 0;
+        if (b == string::npos)
+          continue;
+
+        e = line.find_first_of(ws, b);
+        label.assign(line, b, e - b);
 
-        if (sample.size() == 0)
+        while ((b = line.find_first_not_of(ws, e)) != string::npos) {
+          e = line.find_first_of(ws, b);
+          values.push_back(strtod(line.c_str() + b, NULL)); // this also handles nan and infs correctly
+          n++;
+        }
+
+        if (n == 0)
           continue;
 
-        data.push_back(sample);
+        if (rows == 0) cols = n;
+        else if (n != cols) ragged = true;
+        rows++;
 
         if (o.type!=TIMESERIES)
           break;
       }
 
-      if (data.size() > 0) {
+      if (rows > 0) {
         switch(o.type) {
         case TIMESERIES: {
-          MatrixDouble md(data.size(), data.back().size());
-          md = data;
-          o.t_data = TimeSeriesClassificationSample(o.classkey(label), md);
+          /* rows of differing length do not make up a matrix */
+          MatrixFloat md(ragged ? 0 : rows, ragged ? 0 : cols);
+          for (size_t i=0; !ragged && i<rows; i++)
+            std::copy(values.begin() + i*cols, values.begin() + (i+1)*cols, md[i]);
+          o.t_data.setTrainingSample(o.classkey(label), md);
           break; }
         case CLASSIFICATION:
-          o.c_data = ClassificationSample(o.classkey(label), data.back());
+          o.c_data.set(o.classkey(label), values);
           break;
         default:
           throw invalid_argument("unknown data type");
         }
       }
 
-      if (data.size() != 0) in.clear();
+      if (rows != 0) in.clear();
       return in;
     }
 
@@ -140,6 +161,9 @@ class CsvIOSample {
     }
 
   protected:
+  VectorFloat values;
+  std::string line;
+
   void settype(const std::string &t) {
     using namespace std;
     if (t.find("classification") != string::npos)
@@ -155,43 +179,168 @@ class CsvIOSample {
   }
 };
 
+/* all samples of one input file, parsed with a private labelset */
+class CsvIOFile {
+  public:
+    CsvIOSample io;
+    vector<ClassificationSample> c_data;
+    vector<TimeSeriesClassificationSample> t_data;
+    vector<int> lines; // line number at which each sample ended
+    bool opened;
+
+    CsvIOFile(const CsvIOSample &pristine) : io(pristine), opened(false) {}
+
+    void read(const string &filename) {
+      ifstream fin;
+      if (filename != "-") fin.open(filename);
+      istream &in = filename == "-" ? cin : fin;
+
+      if (!(opened = in.good()))
+        return;
+
+      while (in >> io) {
+        if (io.type == TIMESERIES) t_data.push_back(io.t_data);
+        else c_data.push_back(io.c_data);
+        lines.push_back(io.linenum);
+      }
+    }
+};
+
+/* Reads the samples of all files in order and hands them to
+ * func(io, filename). A single file is read as it arrives. More files are
+ * parsed concurrently, one thread per file and at most one file per core at
+ * a time, and then replayed in file order. The labels are interned into io
+ * on replay, so class ids are the same as for the concatenated files. */
+template <class F>
+bool csvio_files(const vector<string> &files, CsvIOSample &io, F func)
+{
+  if (files.size() == 1) {
+    ifstream fin;
+    if (files[0] != "-") fin.open(files[0]);
+    istream &in = files[0] == "-" ? cin : fin;
+
+    if (!in.good()) {
+      cerr << "unable to open file: " << files[0] << endl;
+      return false;
+    }
+
+    while (in >> io)
+      if (!func(io, files[0]))
+        return false;
+    return true;
+  }
+
+  const CsvIOSample pristine(io);
+  size_t cores = max(thread::hardware_concurrency(), 1u);
+  vector< unique_ptr<CsvIOFile> > parsed(files.size());
+  vector<thread> workers(files.size());
+
+  auto start = [&](size_t i) {
+    parsed[i].reset(new CsvIOFile(pristine));
+    workers[i] = thread(&CsvIOFile::read, parsed[i].get(), files[i]);
+  };
+
+  for (size_t i=0; i<min(cores, files.size()); i++)
+    start(i);
+
+  bool ok = true;
+  for (size_t i=0; i<files.size(); i++) {
+    if (!workers[i].joinable())
+      break;
+    workers[i].join();
+
+    if (ok && i + cores < files.size())
+      start(i + cores);
+
+    CsvIOFile &f = *parsed[i];
+    vector<int> ids(f.io.labelset.size(), -1);
+    auto id = [&](UINT label) {
+      if (ids[label] < 0) ids[label] = io.classkey(f.io.labelset[label]);
+      return (UINT) ids[label];
+    };
+
+    if (ok && !f.opened) {
+      cerr << "unable to open file: " << files[i] << endl;
+      ok = false;
+    }
+
+    if (ok && f.lines.size() > 0 && io.type == UNKNOWN)
+      io.type = f.io.type;
+
+    if (ok && f.lines.size() > 0 && io.type != f.io.type) {
+      cerr << files[i] << ": input type differs from the previous files" << endl;
+      ok = false;
+    }
+
+    for (size_t k=0; ok && k<f.lines.size(); k++) {
+      io.linenum = f.lines[k];
+      if (io.type == TIMESERIES)
+        io.t_data = TimeSeriesClassificationSample(id(f.t_data[k].getClassLabel()), f.t_data[k].getData());
+      else
+        io.c_data = ClassificationSample(id(f.c_data[k].getClassLabel()), f.c_data[k].getSample());
+      ok = func(io, files[i]);
+    }
+
+    parsed[i].reset();
+  }
+
+  return ok;
+}
+
+/* Collects all samples into a GRT dataset. Samples are only appended by
+ * add(), the number of dimensions is set by the first one, and the class
+ * names are set once by finish() after all samples have been added. An
+ * input size in bytes given to reserve() is used to preallocate room for
+ * the samples. */
 class CollectDataset
 {
   public:
   TimeSeriesClassificationData t_data;
   ClassificationData c_data;
   csv_type_t type;
+  size_t size_hint;
 
   CollectDataset() {
     t_data.setAllowNullGestureClass(true);
     c_data.setAllowNullGestureClass(true);
     type = UNKNOWN;
+    size_hint = 0;
   }
 
-  bool add(TimeSeriesClassificationSample &sample, Vector<string> &labels) {
-    type = TIMESERIES;
-    UINT cl = sample.getClassLabel();
+  void reserve(size_t bytes) {
+    size_hint = bytes;
+  }
 
-    if (t_data.getNumDimensions() == 0)
-      t_data.setNumDimensions(sample.getData().getNumCols());
+  bool add(TimeSeriesClassificationSample &sample) {
+    if (type != TIMESERIES) {
+      type = TIMESERIES;
+      if (t_data.getNumDimensions() == 0)
+        t_data.setNumDimensions(sample.getData().getNumCols());
+    }
 
-    if (!t_data.addSample(sample.getClassLabel(), sample.getData()))
-      return false;
-    t_data.setClassNameForCorrespondingClassLabel(labels[cl], cl);
-    return true;
+    return t_data.addSample(sample.getClassLabel(), sample.getData());
   }
 
-  bool add(ClassificationSample &sample, Vector<string> &labels) {
-    type = CLASSIFICATION;
-    UINT cl = sample.getClassLabel();
+  bool add(ClassificationSample &sample) {
+    if (type != CLASSIFICATION) {
+      type = CLASSIFICATION;
+      UINT dims = sample.getSample().size();
+      if (c_data.getNumDimensions() == 0)
+        c_data.setNumDimensions(dims);
 
-    if (c_data.getNumDimensions() == 0)
-      c_data.setNumDimensions(sample.getSample().size());
+      /* guess about eight bytes of text per value, like "-0.1234 " */
+      if (size_hint > 0)
+        c_data.reserve(size_hint / (8 * dims + 2));
+    }
 
-    if (!c_data.addSample(sample.getClassLabel(), sample.getSample()))
-      return false;
-    c_data.setClassNameForCorrespondingClassLabel(labels[cl], cl);
-    return true;
+    return c_data.addSample(sample.getClassLabel(), sample.getSample());
+  }
+
+  void finish(Vector<string> &labels) {
+    for (auto &t : t_data.getClassTracker())
+      t_data.setClassNameForCorrespondingClassLabel(labels[t.classLabel], t.classLabel);
+    for (auto &t : c_data.getClassTracker())
+      c_data.setClassNameForCorrespondingClassLabel(labels[t.classLabel], t.classLabel);
   }
 
   std::string getStatsAsString() {
@@ -217,6 +366,109 @@ class CollectDataset
   }
 };
 
+/* Accumulates the statistics getStatsAsString() of CollectDataset reports,
+ * without keeping the samples. Only the per-class counts, the ranges and the
+ * length of each timeseries are stored, output is the same as GRT's. */
+class DatasetStats
+{
+  public:
+  csv_type_t type = UNKNOWN;
+  UINT dims = 0, samples = 0;
+  std::map<UINT,UINT> counts;   // ordered by class label, like GRT's class tracker
+  std::map<UINT,string> names;
+  Vector<MinMax> ranges;
+  std::vector< std::pair<UINT,UINT> > lengths; // class label and length of each timeseries
+
+  bool add(TimeSeriesClassificationSample &sample, Vector<string> &labels) {
+    type = TIMESERIES;
+    const MatrixFloat &data = sample.getData();
+
+    if (!accept(data.getNumCols()))
+      return false;
+
+    /* GRT seeds the range of every dimension with the very first value */
+    if (samples == 0)
+      for (UINT j=0; j<dims; j++)
+        ranges[j].minValue = ranges[j].maxValue = data[0][0];
+
+    for (UINT i=0; i<data.getNumRows(); i++)
+      for (UINT j=0; j<dims; j++)
+        update(ranges[j], data[i][j]);
+
+    lengths.push_back(make_pair(sample.getClassLabel(), data.getNumRows()));
+    count(sample.getClassLabel(), labels);
+    return true;
+  }
+
+  bool add(ClassificationSample &sample, Vector<string> &labels) {
+    type = CLASSIFICATION;
+    const VectorFloat &data = sample.getSample();
+
+    if (!accept(data.size()))
+      return false;
+
+    if (samples == 0)
+      for (UINT j=0; j<dims; j++)
+        ranges[j].minValue = ranges[j].maxValue = data[j];
+
+    for (UINT j=0; j<dims; j++)
+      update(ranges[j], data[j]);
+
+    count(sample.getClassLabel(), labels);
+    return true;
+  }
+
+  std::string getStatsAsString() {
+    if (type == UNKNOWN)
+      return "unknown datatype";
+
+    stringstream ss;
+    ss << "DatasetName:\tNOT_SET\n"
+       << "DatasetInfo:\t\n"
+       << "Number of Dimensions:\t" << dims << "\n"
+       << "Number of Samples:\t" << samples << "\n"
+       << "Number of Classes:\t" << counts.size() << "\n"
+       << "ClassStats:\n";
+
+    for (auto &c : counts)
+      ss << "ClassLabel:\t" << c.first << "\tNumber of Samples:\t" << c.second << "\tClassName:\t" << names[c.first] << "\n";
+
+    ss << "Dataset Ranges:\n";
+    for (UINT j=0; j<ranges.size(); j++)
+      ss << "[" << j+1 << "] Min:\t" << ranges[j].minValue << "\tMax: " << ranges[j].maxValue << "\n";
+
+    if (type == TIMESERIES) {
+      ss << "Timeseries Lengths:\n";
+      for (auto &l : lengths)
+        ss << "ClassLabel: " << l.first << " Length:\t" << l.second << "\n";
+    }
+
+    return ss.str();
+  }
+
+  protected:
+  /* the first sample sets the number of dimensions, others have to match */
+  bool accept(UINT n) {
+    if (samples == 0) {
+      dims = n;
+      ranges.resize(n);
+    }
+    return n == dims;
+  }
+
+  /* same comparison as GRT's getRanges(), NaNs are skipped */
+  static void update(MinMax &range, Float value) {
+    if (value < range.minValue) range.minValue = value;
+    else if (value > range.maxValue) range.maxValue = value;
+  }
+
+  void count(UINT label, Vector<string> &labels) {
+    if (counts[label]++ == 0)
+      names[label] = labels[label];
+    samples++;
+  }
+};
+
 class CerrLogger : public Observer< GRT::TrainingLogMessage >,
                    public Observer< GRT::TestingLogMessage >,
                    public Observer< GRT::WarningLogMessage >,
@@ -0,0 +1,204 @@
+#include "libgrt_util.h"
+#include "cmdline.h"
+#include "postprocess.h"
+#include "score.h"
+#include "knn.h"
+#include "dtw.h"
+#include "hmm.h"
+
+int main(int argc, char *argv[])
+{
+  cmdline::parser c;
+
+  c.add<int>    ("verbose",       'v', "verbosity level: 0-4", false, 0);
+  c.add         ("help",          'h', "print this message");
+  c.add<string> ("postprocess",   'p', "postprocessor applied to the predictions", false, "none", cmdline::oneof<string>("none","majority","confidence","score","change"));
+  c.add<int>    ("window",        'W', "window size in frames for the postprocessor", false, 10);
+  c.add<double> ("overlap",       'O', "window overlap for the postprocessor", false, 0);
+  c.add<string> ("strategy",      's', "the strategy to resolve multiple groundtruth labels", false, "major", cmdline::oneof<string>("major", "duplicate"));
+  c.add         ("flat",          'f', "line-based output, implies --no-confusion");
+  c.add         ("no-confusion",  'c', "report confusion matrix");
+  c.add         ("no-score",      'n', "report recall, per class and overall");
+  c.add         ("no-ead",        'e', "report event-analysis diagram");
+  c.add<double> ("F-score",       'F', "beta value for F-score, default: 1", false, 1);
+  c.add<int>    ("bootstrap",     'b', "report percentile intervals from this many bootstrap replicates, default: 0 (off)", false, 0);
+  c.add<double> ("confidence",    'C', "confidence level of the bootstrap intervals, default: .95", false, .95, cmdline::range(0.,1.));
+  c.add<int>    ("threads",       'T', "number of threads/cores to use for bootstrapping", false, 4);
+  c.add<int>    ("seed",           0,  "random seed for bootstrapping", false, 0);
+  c.add<double> ("approximate",   'a', "approximate KNN search, neighbours may be up to 1+a times further away, 0 is exact", false, 0);
+  c.add         ("no-native",      0,  "predict KNN, DTW and HMM models through GRT only, without the native search");
+  c.footer      ("[classifier-model-file] [filename]");
+
+  /* parse the classifier-common arguments */
+  if (!c.parse(argc,argv,true) || c.exist("help")) {
+    cerr << c.usage() << "\n" << (c.exist("help") ? "" : c.error()) << "\n" ;
+    return c.exist("help") ? 0 : -1;
+  }
+
+  set_verbosity(c.get<int>("verbose"));
+
+  if (c.exist("flat"))
+    c.set_option("no-confusion");
+
+  if (c.get<int>("bootstrap") < 0 || c.get<int>("threads") < 1) {
+    cerr << c.usage() << endl << "error: --bootstrap and --threads must be positive" << endl;
+    return -1;
+  }
+
+  if (c.exist("no-score") && c.exist("no-confusion") && c.exist("no-ead")) {
+    cerr << c.usage() << endl << "error: --no-confusion, --no-score and --no-ead can not be given at the same time" << endl;
+    return -1;
+  }
+
+  if (c.get<double>("overlap") < 0 || c.get<double>("overlap") >= 1) {
+    cerr << "-O|--overlap must be in the range [0,1)" << endl;
+    return -1;
+  }
+
+  if (c.get<int>("window") <= 0) {
+    cerr << "-W|--window must be larger than 0" << endl;
+    return -1;
+  }
+
+  /* load a classification model */
+  ifstream fin; fin.open(c.rest().size() ? c.rest()[0] : "");
+  istream &model = c.rest().size() ? fin : cin;
+  Classifier *classifier = loadClassifierFromFile(model);
+
+  if (classifier == NULL) {
+    cerr << "unable to load classification model" << endl;
+    return -1;
+  }
+
+  bool native = !c.exist("no-native");
+
+  /* KNN models are searched through a kd-tree instead of GRT's linear scan */
+  unique_ptr<KnnIndex> knn(native ? KnnIndex::fromClassifier(classifier, c.get<double>("approximate")) : NULL);
+
+  istream &in = grt_fileinput(c,1);
+  if (!in) return -1;
+
+  /* set up the postprocessor, change is handled separately */
+  string name = c.get<string>("postprocess");
+  size_t window_size = c.get<int>("window"),
+         hop = ceil(window_size * (1 - c.get<double>("overlap")));
+  Strategy *strategy = NULL;
+
+  if (name == "majority")   strategy = new Majority(window_size);
+  if (name == "confidence") strategy = new Confidence(window_size);
+  if (name == "score")      strategy = new Score(window_size);
+
+  Window window(strategy, window_size, hop, c.get<string>("strategy") == "duplicate");
+
+  /* DTW templates are pruned with lower bounds, unless the confidence is needed */
+  unique_ptr<DtwSearch> dtw(native ? DtwSearch::fromClassifier(classifier, strategy != NULL && strategy->needs_confidence) : NULL);
+
+  /* discrete HMMs advance all class models together on preallocated buffers */
+  unique_ptr<HmmForward> hmm(native ? HmmForward::fromClassifier(classifier) : NULL);
+
+  /* Labels are only passed as integer ids between the stages. Class labels
+   * of the classifier are mapped to ids of their names, with 0 being NULL,
+   * and those ids to the labelset of the scoring group. Both are looked up
+   * once for every label. */
+  LabelSet labels;
+  vector<int> ids, indices;
+  Group group;
+
+  auto id = [&](UINT label) {
+    if (label >= ids.size()) ids.resize(label+1, -1);
+    if (ids[label] < 0)
+      ids[label] = labels.intern(label == 0 ? "NULL" : classifier->getClassNameForLabel(label));
+    return ids[label];
+  };
+
+  auto count = [&](int truth, int prediction) {
+    indices.resize(labels.names.size(), -1);
+    if (indices[prediction] < 0) indices[prediction] = group.index(labels.names[prediction]);
+    if (indices[truth] < 0)      indices[truth]      = group.index(labels.names[truth]);
+    group.add_prediction((size_t) indices[truth], (size_t) indices[prediction]);
+  };
+
+  auto count_window = [&](const vector<int> &truths, int prediction) {
+    for (int truth : truths)
+      count(truth, prediction);
+  };
+
+  /* prepare input */
+  string data_type = classifier->getTimeseriesCompatible() ? "timeseries" : "classification";
+  CsvIOSample io(data_type);
+  Frame last;
+  bool first = true;
+
+  while (in >> io) {
+    UINT label = 0, prediction = 0;
+    bool result = false;
+    Float likelihood = 0;
+
+    switch(io.type) {
+    case TIMESERIES:
+      if (dtw) {
+        result     = dtw->predict(io.t_data.getData());
+        prediction = dtw->predictedClassLabel;
+        likelihood = dtw->maxLikelihood;
+      } else if (hmm) {
+        result     = hmm->predict(io.t_data.getData());
+        prediction = hmm->predictedClassLabel;
+        likelihood = hmm->maxLikelihood;
+      } else {
+        result     = classifier->predict(io.t_data.getData());
+        prediction = classifier->getPredictedClassLabel();
+        likelihood = classifier->getMaximumLikelihood();
+      }
+      label = io.t_data.getClassLabel();
+      break;
+    case CLASSIFICATION:
+      result = knn ? knn->predict(io.c_data.getSample()) : classifier->predict(io.c_data.getSample());
+      label = io.c_data.getClassLabel();
+      prediction = knn ? knn->predictedClassLabel : classifier->getPredictedClassLabel();
+      likelihood = knn ? knn->maxLikelihood : classifier->getMaximumLikelihood();
+      break;
+    default:
+      cerr << "unknown input type" << endl;
+      return -1;
+    }
+
+    if (!result) {
+      cerr << "prediction failed (wrong input type?)" << endl;
+      return -1;
+    }
+
+    Frame f;
+    f.truth      = id(label);
+    f.prediction = id(prediction);
+    f.confidence = likelihood;
+
+    if (strategy != NULL)
+      window.push(f, count_window);
+    else if (name == "change") {
+      /* only count frames in which the labels changed */
+      bool changed = !first && (f.truth != last.truth || f.prediction != last.prediction);
+      if (changed) count(last.truth, last.prediction);
+      if (first || changed) last = f;
+      first = false;
+    } else
+      count(f.truth, f.prediction);
+  }
+
+  if (strategy != NULL)
+    window.finish(count_window);
+
+  if (group.confusion == NULL)
+    return 0;
+
+  double beta = c.get<double>("F-score");
+  group.bootstrap(c.get<int>("bootstrap"), beta, c.get<double>("confidence"), c.get<int>("threads"), c.get<int>("seed"));
+
+  Writer out;
+  if (c.exist("flat"))
+    group.render_flat(out, c, "None", true);
+  else
+    group.render(out, c, "None");
+  out.flush(cout);
+
+  return 0;
+}
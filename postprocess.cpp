@@ -0,0 +1,164 @@
+#include "cmdline.h"
+#include "postprocess.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <stdio.h>
+
+Strategy *strategy_from_args(string, cmdline::parser&, vector<string>&, size_t&, size_t&);
+void missing_confidence();
+
+int main(int argc, const char *argv[])
+{
+  cmdline::parser c;
+  c.add        ("help",     'h', "print this message");
+  c.add        ("no-warn",  'w', "suppress warnings");
+  c.add<string>("strategy", 's', "the strategy to resolve multiple groundtruth labels", false, "major", cmdline::oneof<string>("major", "duplicate"));
+  c.footer     ("<postprocessor> [input-data]...");
+
+  /* parse common arguments */
+  bool parse_ok = c.parse(argc, argv, false) && !c.exist("help");
+
+  string name = c.rest().size() > 0 ? c.rest()[0] : "list";
+  if (name == "list") {
+    cout << c.usage() << endl;
+    cout << "majority" << endl << "confidence" << endl << "score" << endl << "change" << endl;
+    return 0;
+  }
+
+  vector<string> files;
+  size_t window_size = 1, hop = 1;
+  Strategy *strategy = strategy_from_args(name, c, files, window_size, hop);
+
+  if (!parse_ok) {
+    cerr << c.usage() << endl << c.error() << endl;
+    return -1;
+  }
+
+  if (files.size() == 0)
+    files.push_back("-");
+
+  bool warn      = !c.exist("no-warn"),
+       duplicate = c.get<string>("strategy") == "duplicate";
+
+  ios_base::sync_with_stdio(false);
+
+  LabelSet labels;
+  Window window(strategy, window_size, hop, duplicate);
+  vector<string> fields, last_fields;
+  bool first_line = true;
+
+  auto print_window = [&](const vector<int> &truths, int prediction) {
+    if (warn && !duplicate)
+      cerr << "WARNING: multiple groundtruth labels per frame, selecting most commone one: " << labels.names[truths[0]] << "\n";
+    else if (warn)
+      cerr << "WARNING: multiple groundtruth labels per frame, duplicating!\n";
+
+    for (int truth : truths)
+      cout << labels.names[truth] << " " << labels.names[prediction] << "\n";
+  };
+
+  for (auto &filename : files) {
+    ifstream fin;
+    if (filename != "-") fin.open(filename);
+    istream &in = filename == "-" ? cin : fin;
+
+    if (!in.good()) {
+      cerr << "unable to open input file " << filename << endl;
+      return -1;
+    }
+
+    string line, field;
+    while (getline(in, line)) {
+      size_t start = line.find_first_not_of(" \t\r\n\v\f");
+      if (start == string::npos || line[start] == '#')
+        continue;
+
+      fields.clear();
+      stringstream ss(line);
+      while (ss >> field)
+        fields.push_back(field);
+
+      /* only print frames in which the line changed */
+      if (strategy == NULL) {
+        if (!first_line && fields != last_fields) {
+          for (size_t i=0; i<last_fields.size(); i++)
+            cout << (i ? "\t" : "") << last_fields[i];
+          cout << "\n";
+        }
+        if (first_line || fields != last_fields)
+          last_fields.swap(fields);
+        first_line = false;
+        continue;
+      }
+
+      if (fields.size() < 2 || (strategy->needs_confidence && fields.size() < 3))
+        missing_confidence();
+
+      Frame f;
+      f.truth      = labels.intern(fields[0]);
+      f.prediction = labels.intern(fields[1]);
+      f.confidence = strategy->needs_confidence ? strtod(fields[2].c_str(), NULL) : 0;
+
+      window.push(f, print_window);
+    }
+  }
+
+  if (strategy != NULL)
+    window.finish(print_window);
+
+  cout.flush();
+  return 0;
+}
+
+void missing_confidence() {
+  cout.flush();
+  cerr << "ERROR: classfification confidence missing (run predict with -l)" << endl;
+  exit(-1);
+}
+
+Strategy *strategy_from_args(string name, cmdline::parser &c, vector<string> &files, size_t &window, size_t &hop)
+{
+  cmdline::parser p;
+
+  if ( "majority" == name || "confidence" == name || "score" == name ) {
+    p.add<int>   ("window",  'W', "window size in frames to consider", false, 10);
+    p.add<double>("overlap", 'O', "window overlap", false, 0);
+  } else if ( "change" != name ) {
+    cerr << "postprocessor not implemented: " << name << endl;
+    exit(-1);
+  }
+
+  if (c.exist("help")) {
+    cerr << c.usage() << endl << name << " options:" << endl << p.str_options();
+    exit(0);
+  }
+
+  if (!p.parse(c.rest())) {
+    cerr << c.usage() << endl << name << " options:" << endl << p.str_options() << endl << p.error() << endl;
+    exit(-1);
+  }
+
+  files = p.rest();
+
+  if ( "change" == name )
+    return NULL;
+
+  if (p.get<double>("overlap") < 0 || p.get<double>("overlap") >= 1) {
+    cerr << "-O|--overlap must be in the range [0,1)" << endl;
+    exit(-1);
+  }
+
+  if (p.get<int>("window") <= 0) {
+    cerr << "-W|--window must be larger than 0" << endl;
+    exit(-1);
+  }
+
+  window = p.get<int>("window");
+  hop    = ceil(window * (1 - p.get<double>("overlap")));
+
+  if ( "majority" == name )   return new Majority(window);
+  if ( "confidence" == name ) return new Confidence(window);
+  return new Score(window);
+}
@@ -0,0 +1,258 @@
+#ifndef _POSTPROCESS_H_
+#define _POSTPROCESS_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <unordered_map>
+#include <cmath>
+#include <float.h>
+
+using namespace std;
+
+/* labels are interned once and only passed around as integer ids */
+class LabelSet {
+  public:
+  vector<string> names;
+  unordered_map<string,int> ids;
+
+  int intern(const string &name) {
+    auto it = ids.find(name);
+    if (it != ids.end())
+      return it->second;
+    ids[name] = names.size();
+    names.push_back(name);
+    return names.size()-1;
+  }
+};
+
+/* one line of the label stream */
+struct Frame {
+  int truth, prediction;
+  double confidence;
+};
+
+/* Keeps count of each label in the window and the position of its first
+ * occurrence. Positions of the same label are chained through next, so
+ * that removing the front of the window is O(1) as well. */
+class Occurrences {
+  public:
+  vector<size_t> count, first, last, next;
+
+  Occurrences(size_t window) : next(window) {}
+
+  void push(int label, size_t pos) {
+    grow(label);
+    if (count[label] == 0) first[label] = pos;
+    else next[last[label] % next.size()] = pos;
+    last[label] = pos;
+    count[label]++;
+  }
+
+  void pop(int label, size_t pos) {
+    if (--count[label] != 0)
+      first[label] = next[pos % next.size()];
+  }
+
+  /* label with the most occurrences, ties go to the earliest one */
+  int most_common() {
+    int best = -1;
+    for (size_t l=0; l<count.size(); l++) {
+      if (count[l] == 0) continue;
+      if (best < 0 || count[l] > count[best] ||
+          (count[l] == count[best] && first[l] < first[best]))
+        best = l;
+    }
+    return best;
+  }
+
+  /* labels present in the window, in order of first occurrence */
+  vector<int> ordered() {
+    vector<int> labels;
+    for (size_t l=0; l<count.size(); l++)
+      if (count[l] != 0) labels.push_back(l);
+    sort(labels.begin(), labels.end(), [this](int a, int b) { return first[a] < first[b]; });
+    return labels;
+  }
+
+  protected:
+  void grow(int label) {
+    if ((size_t) label < count.size()) return;
+    count.resize(label+1, 0);
+    first.resize(label+1, 0);
+    last.resize(label+1, 0);
+  }
+};
+
+/* The smoothing strategies, each one keeps its own incremental state
+ * which is updated when a frame enters or leaves the window. */
+class Strategy {
+  public:
+  Occurrences predictions;
+  bool needs_confidence;
+
+  Strategy(size_t window, bool confidence) : predictions(window), needs_confidence(confidence) {}
+  virtual ~Strategy() {}
+
+  virtual void push(const Frame &f, size_t pos) { predictions.push(f.prediction, pos); }
+  virtual void pop(const Frame &f, size_t pos)  { predictions.pop(f.prediction, pos); }
+  virtual int  prediction(const deque<Frame> &window, size_t head) = 0;
+};
+
+/* returns only the label with maximum occurence in the given window */
+class Majority : public Strategy {
+  public:
+  Majority(size_t window) : Strategy(window, false) {}
+
+  int prediction(const deque<Frame> &, size_t) {
+    return predictions.most_common();
+  }
+};
+
+/* label of the frame with maximum confidence, the first one on ties. A
+ * monotonic queue of candidates gives the maximum in O(1) amortized. */
+class Confidence : public Strategy {
+  public:
+  deque< pair<size_t,double> > candidates; // position and confidence
+
+  Confidence(size_t window) : Strategy(window, true) {}
+
+  static double key(double v) { return std::isnan(v) ? -INFINITY : v; }
+
+  void push(const Frame &f, size_t pos) {
+    while (!candidates.empty() && key(candidates.back().second) < key(f.confidence))
+      candidates.pop_back();
+    candidates.push_back(make_pair(pos, f.confidence));
+  }
+
+  void pop(const Frame &, size_t pos) {
+    if (!candidates.empty() && candidates.front().first == pos)
+      candidates.pop_front();
+  }
+
+  int prediction(const deque<Frame> &window, size_t head) {
+    return window[candidates.front().first - head].prediction;
+  }
+};
+
+/* label with the highest summed confidence, ties go to the label that
+ * occurs first in the window. Sums are updated incrementally, which is
+ * only off by rounding errors. These are bounded by resynchronizing every
+ * window length, and when two labels come closer than that bound the
+ * window is summed up again in its original order. */
+class Score : public Strategy {
+  public:
+  vector<double> sums, exact;
+  double magnitude = 0; // sum of absolute confidences in the window
+  size_t size, updates = 0;
+
+  Score(size_t window) : Strategy(window, true), size(window) {}
+
+  void push(const Frame &f, size_t pos) {
+    Strategy::push(f, pos);
+    if ((size_t) f.prediction >= sums.size()) sums.resize(f.prediction+1, 0);
+    sums[f.prediction] += f.confidence;
+    magnitude += fabs(f.confidence);
+    updates++;
+  }
+
+  void pop(const Frame &f, size_t pos) {
+    Strategy::pop(f, pos);
+    // start over from an exact zero, so rounding errors do not accumulate
+    if (predictions.count[f.prediction] == 0) sums[f.prediction] = 0;
+    else sums[f.prediction] -= f.confidence;
+    magnitude -= fabs(f.confidence);
+    updates++;
+  }
+
+  int prediction(const deque<Frame> &window, size_t) {
+    if (updates > 2*size) {
+      summarize(window, sums);
+      magnitude = 0;
+      for (auto &f : window) magnitude += fabs(f.confidence);
+      updates = 0;
+    }
+
+    vector<int> labels = predictions.ordered();
+    int best = -1;
+    for (int l : labels)
+      if (best < 0 || sums[l] > sums[best])
+        best = l;
+
+    double bound = 8 * (updates + window.size()) * DBL_EPSILON * magnitude;
+    for (int l : labels)
+      if (l != best && fabs(sums[best] - sums[l]) <= bound)
+        return tie_break(window, labels);
+
+    return best;
+  }
+
+  protected:
+  void summarize(const deque<Frame> &window, vector<double> &result) {
+    result.assign(sums.size(), 0);
+    for (auto &f : window)
+      result[f.prediction] += f.confidence;
+  }
+
+  int tie_break(const deque<Frame> &window, const vector<int> &labels) {
+    int best = -1;
+    summarize(window, exact);
+    for (int l : labels)
+      if (best < 0 || exact[l] > exact[best])
+        best = l;
+    return best;
+  }
+};
+
+/* Slides the window over a stream of frames, every full window and the
+ * remainder at the end of the stream is handed to emit() together with the
+ * groundtruth labels for it. These are either the label of the first frame
+ * or, duplicated, every groundtruth label in the window. */
+class Window {
+  public:
+  Strategy *strategy;
+  Occurrences truths;
+  deque<Frame> frames;
+  size_t size, hop, head = 0; // stream position of the first frame in the window
+  bool duplicate;
+  vector<int> selected;
+
+  Window(Strategy *s, size_t window, size_t h, bool dup) : strategy(s), truths(window), size(window), hop(h), duplicate(dup) {}
+
+  template< class F> void push(const Frame &f, F emit) {
+    size_t pos = head + frames.size();
+    frames.push_back(f);
+    truths.push(f.truth, pos);
+    strategy->push(f, pos);
+
+    if (frames.size() < size)
+      return;
+
+    process(emit);
+    for (size_t i=0; i<hop && !frames.empty(); i++, head++) {
+      truths.pop(frames.front().truth, head);
+      strategy->pop(frames.front(), head);
+      frames.pop_front();
+    }
+  }
+
+  template< class F> void finish(F emit) {
+    if (!frames.empty())
+      process(emit);
+  }
+
+  protected:
+  template< class F> void process(F emit) {
+    int prediction = strategy->prediction(frames, head);
+
+    if (duplicate)
+      selected = truths.ordered();
+    else
+      selected.assign(1, frames.front().truth);
+
+    emit(selected, prediction);
+  }
+};
+
+#endif
@@ -7,7 +7,6 @@
 using namespace std;
 using namespace dlib;
 
-a_df df_from_stream(istream &model);
 
 //_______________________________________________________________________________________________________
 int main(int argc, char *argv[])
@@ -26,6 +25,9 @@ int main(int argc, char *argv[])
   cmdline::parser c;
 
   c.add        ("help",    'h', "print this message");
+  c.add<int>   ("threads", 'T', "number of threads/cores to use", false, 4);
+  c.add<int>   ("batch",   'b', "number of samples that are read and predicted at once, defaults to 1 when streaming", false, 1024);
+  c.add        ("stream",  's', "predict samples as they arrive until the end of the input, instead of up to the first empty line");
   c.footer     ("[classifier-model-file] [testsample-file]...");
 
   /* parse common arguments */
@@ -39,6 +41,11 @@ int main(int argc, char *argv[])
     return 0;
   }
 
+  if (c.get<int>("threads") < 1 || c.get<int>("batch") < 1) {
+    cerr << "--threads and --batch must be larger than 0" << endl;
+    return -1;
+  }
+
   string model_file = c.rest().size() > 1 ? c.rest()[1] : "";
   string tests_file = c.rest().size() > 2 ? c.rest()[2] : "";
 
@@ -60,146 +67,100 @@ int main(int argc, char *argv[])
     return -1;
   }
 
-  a_df df = df_from_stream(model);
-
-
-
-  /*
-      ########  ########    ###    ########      ######     ###    ##     ## ########  ##       ########  ######
-      ##     ## ##         ## ##   ##     ##    ##    ##   ## ##   ###   ### ##     ## ##       ##       ##    ##
-      ##     ## ##        ##   ##  ##     ##    ##        ##   ##  #### #### ##     ## ##       ##       ##
-      ########  ######   ##     ## ##     ##     ######  ##     ## ## ### ## ########  ##       ######    ######
-      ##   ##   ##       ######### ##     ##          ## ######### ##     ## ##        ##       ##             ##
-      ##    ##  ##       ##     ## ##     ##    ##    ## ##     ## ##     ## ##        ##       ##       ##    ##
-      ##     ## ######## ##     ## ########      ######  ##     ## ##     ## ##        ######## ########  ######
-  */
-
-  /* read samples */
-  std::vector<sample_type> samples;
-  std::vector<string> labels;
-  std::set<string> u_labels;
-
-  string line, label;
-
-  while (getline(tests, line)) {
-    stringstream ss(line);
-
-    if (line.find_first_not_of(" \t") == string::npos) {
-      if (samples.size() != 0)
-        break;
-      else
-        continue;
-    }
-
-    if (line[0] == '#')
-      continue;
+  /* when streaming, wait until the first data has arrived before reading the model, which may still be
+   * in training, and predict every sample right away unless a batch size is given */
+  bool stream = c.exist("stream");
+  size_t batch = stream && !c.exist("batch") ? 1 : c.get<int>("batch");
 
-    ss >> label;
-    std::vector<double> sample;
-    string val;
-    while (ss >> val) // this also handles nan and infs correctly
-      sample.push_back(strtod(val.c_str(), NULL));
+  if (stream)
+    tests.peek();
 
-    if (sample.size() == 0)
-      continue;
-
-    samples.push_back(mat(sample));
-    labels.push_back(label);
-    u_labels.insert(label);
+  /* the model header names trainer and kernel, the precision and the number of dimensions */
+  model_header header;
+  if (!readHeader(model, header)) {
+    cerr << "unable to read the model header, unknown trainer or newer model version" << endl;
+    return -1;
   }
 
+  long dims = header.dims;
 
+  // the decision function is instantiated for the sample type matching the precision and number of dimensions
+  return dispatch_sample_type(header.precisionName(), dims, [&](auto tag) {
+    typedef typename decltype(tag)::type S;
+    SAMPLE_TRAITS(S)
 
-  /*
-   * PREDICTION
-   */
-
-  for (size_t i = 0; i < samples.size(); ++i)
-    cout << labels[i] << "\t" << df(samples[i]) << endl;
-
-
-  cout << endl;
-  return 0;
-}
-
-
-
-
+    a_df df;
+    if (!model_format<S>::read(model, header, df)) {
+      cerr << "unable to load a " << TrainerName::_from_integral(header.trainer)._to_string() << " model with kernel "
+           << KernelName::_from_integral(header.kernel)._to_string() << ", corrupted or unknown" << endl;
+      return -1;
+    }
 
-//_______________________________________________________________________________________________________
-a_df df_from_stream(istream &model) {
-  a_df df;
 
-  char t[32], k[32];
-  model.getline(t, 32);
-  model.getline(k, 32);
 
-  string trainer(t), kernel(k);
+    /*
+        ########  ########    ###    ########      ######     ###    ##     ## ########  ##       ########  ######
+        ##     ## ##         ## ##   ##     ##    ##    ##   ## ##   ###   ### ##     ## ##       ##       ##    ##
+        ##     ## ##        ##   ##  ##     ##    ##        ##   ##  #### #### ##     ## ##       ##       ##
+        ########  ######   ##     ## ##     ##     ######  ##     ## ## ### ## ########  ##       ######    ######
+        ##   ##   ##       ######### ##     ##          ## ######### ##     ## ##        ##       ##             ##
+        ##    ##  ##       ##     ## ##     ##    ##    ## ##     ## ##     ## ##        ##       ##       ##    ##
+        ##     ## ######## ##     ## ########      ######  ##     ## ##     ## ##        ######## ########  ######
+    */
+
+    /* samples are read in batches, so memory does not grow with the number of samples. the predictions of a
+     * batch are distributed on all threads, each block of samples reuses one sample matrix, and written in
+     * order once the batch is complete. */
+    sample_store store;
+    std::vector<string> lines;
+    thread_pool pool(c.get<int>("threads"));
+
+    store.stop_at_blank = !stream;
+
+    while (!store.end) {
+      store.clear();
+
+      if (!store.read(tests, batch)) {
+        cerr << "all samples must have the same number of dimensions" << endl;
+        return -1;
+      }
+
+      if (dims != 0 && store.size() > 0 && store.dims != dims) {
+        cerr << "the model was trained on samples with " << dims << " dimensions, not " << store.dims << endl;
+        return -1;
+      }
+
+
+
+      /*
+       * PREDICTION
+       */
+
+      auto predict = [&](long begin, long end) {
+        sample_type sample;
+        for (long i = begin; i < end; ++i) {
+          store.copy_to(i, sample);
+          lines[i].assign(store.labels[i]);
+          lines[i] += "\t";
+          lines[i] += df(sample);
+          lines[i] += "\n";
+        }
+      };
+
+      // single samples, e.g. when streaming, are not worth waking up the pool
+      lines.resize(store.size());
+      if (store.size() > 1)
+        parallel_for_blocked(pool, 0, store.size(), predict);
+      else
+        predict(0, store.size());
 
-  if (trainer == TrainerName::ONE_VS_ONE) {
-    if (kernel == "hist") {
-      df.get<ovo_trained_function_type_hist_df>();
-      deserialize(df.cast_to<ovo_trained_function_type_hist_df>(), model);
-    }
-    else if (kernel == "lin") {
-      df.get<ovo_trained_function_type_lin_df>();
-      deserialize(df.cast_to<ovo_trained_function_type_lin_df>(), model);
+      for (auto &line : lines)
+        cout << line;
+      cout.flush();
     }
-    else if (kernel == "lin_no") {
-      df.get<ovo_trained_function_type_lin_no_df>();
-      deserialize(df.cast_to<ovo_trained_function_type_lin_no_df>(), model);
-    }
-    else if (kernel == "rbf") {
-      df.get<ovo_trained_function_type_rbf_df>();
-      deserialize(df.cast_to<ovo_trained_function_type_rbf_df>(), model);
-    }
-    else if (kernel == "poly") {
-      df.get<ovo_trained_function_type_poly_df>();
-      deserialize(df.cast_to<ovo_trained_function_type_poly_df>(), model);
-    }
-    else if (kernel == "sig") {
-      df.get<ovo_trained_function_type_sig_df>();
-      deserialize(df.cast_to<ovo_trained_function_type_sig_df>(), model);
-    }
-    else {
-      df.get<ovo_trained_function_type>();
-      deserialize(df.cast_to<ovo_trained_function_type>(), model);
-    }
-  }
-  else if (trainer == TrainerName::ONE_VS_ALL) {
-    if (kernel == "hist") {
-      df.get<ova_trained_function_type_hist_df>();
-      deserialize(df.cast_to<ova_trained_function_type_hist_df>(), model);
-    }
-    else if (kernel == "lin") {
-      df.get<ova_trained_function_type_lin_df>();
-      deserialize(df.cast_to<ova_trained_function_type_lin_df>(), model);
-    }
-    else if (kernel == "lin_no") {
-      df.get<ova_trained_function_type_lin_no_df>();
-      deserialize(df.cast_to<ova_trained_function_type_lin_no_df>(), model);
-    }
-    else if (kernel == "rbf") {
-      df.get<ova_trained_function_type_rbf_df>();
-      deserialize(df.cast_to<ova_trained_function_type_rbf_df>(), model);
-    }
-    else if (kernel == "poly") {
-      df.get<ova_trained_function_type_poly_df>();
-      deserialize(df.cast_to<ova_trained_function_type_poly_df>(), model);
-    }
-    else if (kernel == "sig") {
-      df.get<ova_trained_function_type_sig_df>();
-      deserialize(df.cast_to<ova_trained_function_type_sig_df>(), model);
-    }
-    else {
-      df.get<ova_trained_function_type>();
-      deserialize(df.cast_to<ova_trained_function_type>(), model);
-    }
-  }
-  else if (trainer == TrainerName::SVM_MULTICLASS_LINEAR) {
-    df.get<svm_ml_trained_function_type>();
-    deserialize(df.cast_to<svm_ml_trained_function_type>(), model);
-  }
 
-  return df;
+
+    cout << endl;
+    return 0;
+  });
 }
@@ -1,5 +1,9 @@
 #include "libgrt_util.h"
 #include "cmdline.h"
+#include "knn.h"
+#include "dtw.h"
+#include "hmm.h"
+#include "compiled.h"
 
 int main(int argc, char *argv[]) 
 {
@@ -10,6 +14,11 @@ int main(int argc, char *argv[])
   c.add        ("help",       'h', "print this message");
   c.add        ("likelihood", 'l', "print label_prediction likelihood instead of label and prediction");
   c.add        ("null",       'n', "draw labels randomly from the set of labels (for testing the chain)");
+  c.add<double>("approximate",'a', "approximate KNN search, neighbours may be up to 1+a times further away, 0 is exact", false, 0);
+  c.add<double>("spot",       's', "spot the templates of a DTW model in a continuous stream, closer than this distance per template sample, 0 is off", false, 0);
+  c.add        ("incremental",'i', "predict HMM models after each sample on the samples since the label last changed, carrying the forward pass on instead of going over them again");
+  c.add<string>("compiled",   'c', "shared library of the model, as built by grt compile", false, "");
+  c.add        ("no-native",   0,  "predict KNN, DTW and HMM models through GRT only, without the native search");
   c.footer     ("[classifier-model-file] [filename]...");
 
   /* parse the classifier-common arguments */
@@ -19,10 +28,17 @@ int main(int argc, char *argv[])
   }
 
   set_verbosity(c.get<int>("verbose"));
+  set_running_indicator(&is_running);
 
   /* wait until first data has arrived before trying to read the
    * classifier, to catch cases where the training has not yet been
-   * completed, and he classifier has not yet been written to disk */
+   * completed, and he classifier has not yet been written to disk.
+   * With multiple input files this waits on the first one, all of them
+   * are then read in parallel after loading the model. */
+  vector<string> files;
+  if (c.rest().size() > 2)
+    files.assign(c.rest().begin() + 1, c.rest().end());
+
   istream &in = grt_fileinput(c,1);
   in.peek(); // block until data there
 
@@ -54,55 +70,177 @@ int main(int argc, char *argv[])
     return -1;
   }
 
+  bool native = !c.exist("no-native");
+
+  /* KNN models are searched through a kd-tree instead of GRT's linear scan */
+  unique_ptr<KnnIndex> knn(native ? KnnIndex::fromClassifier(classifier, c.get<double>("approximate")) : NULL);
+
+  /* DTW templates are pruned with lower bounds, likelihoods need all of them */
+  unique_ptr<DtwSearch> dtw(native ? DtwSearch::fromClassifier(classifier, c.exist("likelihood")) : NULL);
+
+  /* HMMs advance all models together on preallocated buffers */
+  unique_ptr<HmmForward> hmm(native ? HmmForward::fromClassifier(classifier) : NULL);
+
+  /* tree models run as the native code grt compile built from them */
+  unique_ptr<CompiledModel> compiled;
+  if (c.get<string>("compiled") != "") {
+    compiled.reset(CompiledModel::fromFile(c.get<string>("compiled"), classifier));
+    if (!compiled) {
+      cerr << "unable to load compiled model: " << c.get<string>("compiled") << endl;
+      return -1;
+    }
+  }
+
+  /* spotting reads single samples, and reports matches as they are found */
+  unique_ptr<DtwSpotter> spotter;
+  if (c.get<double>("spot") > 0) {
+    spotter.reset(DtwSpotter::fromClassifier(classifier, c.get<double>("spot")));
+    if (!spotter) {
+      cerr << "spotting needs a trained DTW model without preprocessing" << endl;
+      return -1;
+    }
+  }
+
+  /* incremental prediction reads single samples, and grows the timeseries
+   * until the label changes */
+  unique_ptr<HmmForward> stream;
+  if (c.exist("incremental")) {
+    stream.reset(HmmForward::fromClassifier(classifier));
+    if (!stream || spotter) {
+      cerr << "incremental prediction needs a trained HMM model, without null rejection if continuous, and no --spot" << endl;
+      return -1;
+    }
+  }
+
   /* prepare input */
-  string data_type = classifier->getTimeseriesCompatible() ? "timeseries" : "classification";
+  string data_type = classifier->getTimeseriesCompatible() && !spotter && !stream ? "timeseries" : "classification";
   CsvIOSample io(data_type);
 
-  while( in >> io && is_running ) {
+  vector<DtwSpotter::Detection> found;
+  auto report = [&]() {
+    for (auto &d : found)
+      cout << classifier->getClassNameForLabel(d.label) << "\t" << d.start << "\t" << d.end << "\t" << d.distance << endl;
+    found.clear();
+  };
+
+  auto spot = [&](CsvIOSample &io) {
+    if (io.type != CLASSIFICATION || !spotter->push(io.c_data.getSample(), found)) {
+      cerr << "spotting failed (wrong input type?)" << endl;
+      return false;
+    }
+    report();
+    return true;
+  };
+
+  auto output = [&](UINT label, UINT prediction, Float likelihood) {
+    string s_label = label == 0 ? "NULL" : classifier->getClassNameForLabel(label),
+           s_prediction = prediction == 0 ? "NULL" : classifier->getClassNameForLabel(prediction);
+
+    /*
+     * replace the prediction with a random choice from the labelset
+     */
+    if (c.exist("null")) {
+      UINT index = (UINT) round(drand48() * (classifier->getNumClasses()-1));
+      s_prediction = index == 0 ? "NULL" : classifier->getClassNameForLabel(index);
+    }
+
+    if (c.exist("likelihood"))
+      cout << s_label << "\t" << s_prediction << "\t" << likelihood << endl;
+    else
+      cout << s_label << "\t" << s_prediction << endl;
+  };
+
+  UINT last_label = 0;
+  string last_file;
+  auto incremental = [&](CsvIOSample &io, const string &file) {
+    if (io.type != CLASSIFICATION) {
+      cerr << "incremental prediction failed (wrong input type?)" << endl;
+      return false;
+    }
+
+    UINT label = io.c_data.getClassLabel();
+    if (label != last_label || file != last_file)
+      stream->reset();
+    last_label = label;
+    last_file = file;
+
+    if (!stream->push(io.c_data.getSample()) || !stream->classify()) {
+      cerr << "prediction failed (wrong input type?)" << endl;
+      return false;
+    }
+
+    output(label, stream->predictedClassLabel, stream->maxLikelihood);
+    return true;
+  };
+
+  auto predict = [&](CsvIOSample &io) {
     UINT prediction = 0, label = 0;
-    string s_prediction, s_label;
     bool result = false;
+    Float likelihood = 0;
 
     switch(io.type) {
     case TIMESERIES:
-      result = classifier->predict(io.t_data.getData());
+      if (dtw) {
+        result     = dtw->predict(io.t_data.getData());
+        prediction = dtw->predictedClassLabel;
+        likelihood = dtw->maxLikelihood;
+      } else if (hmm) {
+        result     = hmm->predict(io.t_data.getData());
+        prediction = hmm->predictedClassLabel;
+        likelihood = hmm->maxLikelihood;
+      } else {
+        result     = classifier->predict(io.t_data.getData());
+        prediction = classifier->getPredictedClassLabel();
+        likelihood = classifier->getMaximumLikelihood();
+      }
       label = io.t_data.getClassLabel();
-      s_label = classifier->getClassNameForLabel(label);
-      prediction = classifier->getPredictedClassLabel();
-      s_prediction = classifier->getClassNameForLabel(prediction);
       break;
     case CLASSIFICATION:
-      result = classifier->predict(io.c_data.getSample());
+      if (compiled) {
+        result     = compiled->predict(io.c_data.getSample());
+        prediction = compiled->predictedClassLabel;
+        likelihood = compiled->maxLikelihood;
+      } else if (knn) {
+        result     = knn->predict(io.c_data.getSample());
+        prediction = knn->predictedClassLabel;
+        likelihood = knn->maxLikelihood;
+      } else {
+        result     = classifier->predict(io.c_data.getSample());
+        prediction = classifier->getPredictedClassLabel();
+        likelihood = classifier->getMaximumLikelihood();
+      }
       label = io.c_data.getClassLabel();
-      s_label = classifier->getClassNameForLabel(label);
-      prediction   = classifier->getPredictedClassLabel();
-      s_prediction = classifier->getClassNameForLabel(prediction);
       break;
     default:
       cerr << "unknown input type" << endl;
-      return -1;
+      return false;
     }
 
     if (!result) {
       cerr << "prediction failed (wrong input type?)" << endl;
-      return -1;
+      return false;
     }
 
-    if (label == 0) s_label = "NULL";
-    if (prediction == 0) s_prediction = "NULL";
+    output(label, prediction, likelihood);
+    return true;
+  };
 
-    /*
-     * replace the prediction with a random choice from the labelset
-     */
-    if (c.exist("null")) {
-      UINT index = (UINT) round(drand48() * (classifier->getNumClasses()-1));
-      s_prediction = index == 0 ? "NULL" : classifier->getClassNameForLabel(index);
-    }
+  /* an interrupt stops between samples, what was found so far is kept */
+  auto process = [&](CsvIOSample &io, const string &file) {
+    return is_running && (spotter ? spot(io) : stream ? incremental(io, file) : predict(io));
+  };
 
-    if (c.exist("likelihood"))
-      cout << s_label << "\t" << s_prediction << "\t" << classifier->getMaximumLikelihood() << endl;
-    else
-      cout << s_label << "\t" << s_prediction << endl;
+  if (files.size() > 0) {
+    if (!csvio_files(files, io, process) && is_running)
+      return -1;
+  } else
+    while (in >> io && is_running)
+      if (!process(io, "-") && is_running)
+        return -1;
+
+  if (spotter) {
+    spotter->finish(found);
+    report();
   }
 
   cout << endl;
@@ -0,0 +1,897 @@
+#ifndef _SCORE_H_
+#define _SCORE_H_
+
+#include "libgrt_util.h"
+#include "cmdline.h"
+#include <stdint.h>
+#include <math.h>
+#include <unordered_map>
+#include <regex>
+#include <algorithm>
+#include <functional>
+#include <cctype>
+#include <locale>
+#include <random>
+#include <thread>
+#include <numeric>
+#include <inttypes.h>
+
+/* append-only output buffer. One instance is reused for all groups, so
+ * once it has grown to the size of a report rendering does not allocate.
+ * Numbers are formatted in place, %f for what used to go through
+ * std::to_string and %g for what used to be streamed. */
+class Writer {
+  public:
+  string buf;
+
+  Writer& append(const char *s, size_t len) { buf.append(s, len); return *this; }
+  Writer& operator<<(const string &s) { buf.append(s); return *this; }
+  Writer& operator<<(const char *s)   { buf.append(s); return *this; }
+  Writer& operator<<(char c)          { buf.push_back(c); return *this; }
+  Writer& operator<<(double v)        { return format("%g", v); }
+  Writer& fixed(double v)             { return format("%f", v); }
+  Writer& fixed_or_zero(double v)     { return std::isnan(v) ? *this << '0' : fixed(v); }
+  Writer& pad(size_t n, char c=' ')   { buf.append(n, c); return *this; }
+
+  Writer& centered(int tab_size, const char *val, size_t len, int DEFAULT=5);
+  Writer& centered(int tab_size, const char *val, int DEFAULT=5) { return centered(tab_size, val, strlen(val), DEFAULT); }
+  Writer& centered(int tab_size, const string &val, int DEFAULT=5) { return centered(tab_size, val.data(), val.size(), DEFAULT); }
+  Writer& centered(int tab_size, double value, int DEFAULT=5);
+  Writer& centered(int tab_size, uint64_t value, int DEFAULT=5);
+  Writer& centered_or_empty(int tab_size, double value);
+  Writer& interval(int tab_size, pair<double,double> ci);
+  Writer& meanstd(int tab_size, const vector<double> &list);
+  Writer& mean(const vector<double> &list);
+
+  template< class T> Writer& format(const char *fmt, T value) {
+    size_t at = buf.size();
+    buf.resize(at + 32);
+    int len = snprintf(&buf[at], 32, fmt, value);
+    if (len >= 32) {
+      buf.resize(at + len + 1);
+      snprintf(&buf[at], len + 1, fmt, value);
+    }
+    buf.resize(at + len);
+    return *this;
+  }
+
+  /* hand the buffer to the stream once it holds at least threshold bytes */
+  void flush(ostream &os, size_t threshold=0) {
+    if (buf.size() < threshold) return;
+    os.write(buf.data(), buf.size());
+    buf.clear();
+  }
+};
+
+class Group {
+  public:
+  Matrix<uint64_t> *confusion = NULL;
+  vector<string> labelset;
+  vector<string> lines;
+
+  void add_prediction(string, string);
+  void add_prediction(size_t label, size_t prediction);
+  size_t index(const string &label);
+  void calculate_score(double beta);
+  void calculate_ead();
+  double get_meanscore(string, double);
+  void bootstrap(size_t replicates, double beta, double level, unsigned threads, unsigned seed);
+
+  vector< uint64_t > TP,TN,FP,FN;
+  vector< double >   Fbeta,recall,precision,TNR,NPV,accuracy;
+
+  /* percentile intervals per class, the last entry is the class mean */
+  vector< pair<double,double> > Fbeta_ci,recall_ci,precision_ci;
+
+  void render(Writer&, cmdline::parser&, string tag);
+  void render_flat(Writer&, cmdline::parser&, string tag, bool first);
+
+  bool scored = false; // scores are up-to-date with the confusion matrix
+
+  /* indices into the labelset, the NULL label is always -1 */
+  int64_t last_label = -1, last_prediction = -1, null_index = -1;
+
+  struct { // EAD errors according to Ward et.al. 2011
+    uint64_t deletions = 0,
+             ev_fragmented = 0,
+             ev_fragmerged = 0,
+             ev_merged = 0,
+             correct = 0,
+             re_merged = 0,
+             re_fragmerged = 0,
+             re_fragmented = 0,
+             insertions = 0;
+  } ead;
+
+  uint64_t groundtruth_changed = 0,
+           prediction_changed  = 0,
+           total_frames        = 0;
+};
+
+/* some helper functions */
+bool   value_differs(map<double,string>&, map<double,string>&);
+int    push_back_if_not_there(const string &label, vector<string> &labelset);
+string bootstrap_groups(unordered_map<string,Group>&, size_t, double, double, unsigned, unsigned);
+void   score_counts(const uint64_t*, size_t, double, double*, double*, double*);
+void   resample_counts(const vector<uint64_t>&, uint64_t, mt19937_64&, vector<uint64_t>&);
+pair<double,double> percentile_interval(double*, size_t, double);
+template< class F> void parallel_for(size_t n, unsigned threads, F func);
+template< class T> vector<T>  diag(Matrix<T> &m);
+template< class T> T          sum(vector<T> m);
+template< class T> T          sum(Matrix<T> &m);
+template< class T> vector<T>  abs(vector<T> m);
+template< class T> vector<T>  pow(vector<T> m, double pow);
+template< class T> vector<T>  rowsum(Matrix<T> &m);
+template< class T> vector<T>  colsum(Matrix<T> &m);
+template< class T> Matrix<T>* resize_matrix(Matrix<T> *old, size_t newsize);
+template< class T> vector<T>  operator-(const std::vector<T> &a, const std::vector<T> &b);
+template< class T> vector<T>  operator+(const std::vector<T> &a, const std::vector<T> &b);
+template< class T> vector<T>  operator*(T a, const std::vector<T> &b);
+template< class T> vector<T>  operator-(T a, const std::vector<T> &b);
+template< class T> vector<T>  operator-(const std::vector<T> &b, T a);
+template< class T> vector<T>  operator+(T a, const std::vector<T> &b);
+
+/* index of a label in the labelset, which is added if not there yet */
+size_t Group::index(const string &label)
+{
+  size_t idx = push_back_if_not_there(label, labelset);
+  if (label == "NULL") null_index = idx;
+  return idx;
+}
+
+void Group::add_prediction(string label, string prediction)
+{
+  size_t idxA = index(prediction),
+         idxB = index(label);
+
+  add_prediction(idxB, idxA);
+}
+
+void Group::add_prediction(size_t idxLabel, size_t idxPrediction)
+{
+  /* first we calculate your every-day confusion matrix, which
+   * is later used to calculate TP,TN,FN,FP scores and their stats */
+  if (confusion == NULL)
+    confusion = new Matrix<uint64_t>();
+
+  if (confusion->getNumRows() != labelset.size())
+    confusion = resize_matrix(confusion, labelset.size());
+
+  (*confusion)[idxPrediction][idxLabel] += 1;
+  scored = false;
+
+  int64_t label      = (int64_t) idxLabel == null_index ? -1 : idxLabel,
+          prediction = (int64_t) idxPrediction == null_index ? -1 : idxPrediction;
+
+  /* events are hit when both labels are NULL, with one exception handled
+   * when a double-NULL was encountered */
+  if ( (last_label!=label && last_prediction!=prediction) ||
+       (label==-1 && prediction==-1) ) {
+    calculate_ead();
+    prediction_changed = groundtruth_changed = 0;
+    last_prediction = last_label = -1;
+  }
+
+  /* and then we also calculate the more in-depth analysis of Ward et.al.
+   * - Performance Metrics for Activity Recognition.
+   *
+   * For this we need to keep track of the next and last label to score,
+   * one call before this one. */
+  groundtruth_changed += label!=last_label;
+  prediction_changed  += prediction!=last_prediction;
+
+  /* compress label sequences into one last_label */
+  last_label      = label;
+  last_prediction = prediction;
+}
+
+void Group::calculate_ead()
+{
+  if ( prediction_changed==0 && groundtruth_changed==0 )
+    return;
+
+  groundtruth_changed -= floor(groundtruth_changed/2);
+  prediction_changed  -= floor(prediction_changed/2);
+
+  // DEBUG
+  // cerr << groundtruth_changed << "\t" << prediction_changed << endl;
+
+  /* now for each of the error cases */
+  if (prediction_changed == 0 && groundtruth_changed == 1) { // deletion
+    ead.deletions++;
+  } else if ( groundtruth_changed == 0 && prediction_changed == 1) {
+    ead.insertions++;
+  } else if ( groundtruth_changed == 1 && prediction_changed < 2 ) {
+    ead.correct++;
+  } else if ( groundtruth_changed == 1 && prediction_changed > 1 ) {
+    ead.ev_fragmented += groundtruth_changed;
+    ead.re_fragmented += prediction_changed;
+  } else if ( groundtruth_changed > 1 && prediction_changed == 1) {
+    ead.ev_merged += groundtruth_changed;
+    ead.re_merged += prediction_changed;
+  } else if ( groundtruth_changed > 1 && prediction_changed > 1) {
+    ead.ev_fragmerged += groundtruth_changed;
+    ead.re_fragmerged += prediction_changed;
+  } else
+    cerr << "this never happened" << endl;
+}
+
+void Group::calculate_score(double beta)
+{
+  if (confusion == NULL || scored) return;
+  scored = true;
+
+  // see https://en.wikipedia.org/wiki/Precision_and_recall
+  vector<uint64_t> TP = diag(*confusion);
+  vector<uint64_t> FP = rowsum(*confusion) - TP;
+  vector<uint64_t> TN = sum(*confusion) - colsum(*confusion) - rowsum(*confusion) + TP;
+  vector<uint64_t> FN = colsum(*confusion) - TP;
+
+  recall.clear(); precision.clear(); Fbeta.clear(); accuracy.clear();
+  NPV.clear(); TNR.clear();
+  for (size_t i=0; i<labelset.size(); i++) {
+    accuracy.push_back( (TP[i] + TN[i]) / (double) (TP[i] + FP[i] + TN[i] + FN[i]) );
+    recall.push_back( TP[i] / (double) (TP[i] + FN[i]) );
+    precision.push_back( TP[i] / (double) (TP[i] + FP[i]) );
+    NPV.push_back( TN[i] / (double) (FN[i] + TN[i]) );
+    TNR.push_back( TN[i] / (double) (TN[i] + FP[i]) );
+    Fbeta.push_back( (1+pow(beta,2)) * (precision[i] * recall[i])/(pow(beta,2)*precision[i] + recall[i]) );
+  }
+
+  /* TODO prior to printing anythign we re-calc, this may be wrong here */
+  //add_prediction("NULL","NULL");
+  calculate_ead();
+}
+
+double Group::get_meanscore(string which, double beta)
+{
+  vector<double> *score, nonan;
+  calculate_score(beta);
+
+  if (which.find("none") != string::npos)           return 0;
+  else if (which.find("Fbeta") != string::npos)     score = &Fbeta;
+  else if (which.find("recall") != string::npos)    score = &recall;
+  else if (which.find("precision") != string::npos) score = &precision;
+  else if (which.find("NPV") != string::npos)       score = &NPV;
+  else if (which.find("TNR") != string::npos)       score = &TNR;
+  else if (which.find("accuracy") != string::npos)    score = &accuracy;
+  else return 0;
+
+  for (auto val : *score)
+    if (!std::isnan(val))
+      nonan.push_back(val);
+    else
+      nonan.push_back(0.);
+
+  return nonan.size()==0 ? 0. : sum(nonan)/nonan.size();
+}
+
+void Group::render_flat(Writer &out, cmdline::parser &c, string tag, bool printheader) {
+  calculate_score(c.get<double>("F-score"));
+
+  if (c.exist("no-score"))
+    return;
+
+  /* print out comment attached to this group if any */
+  for( auto &line : lines )
+    if ( line[0] == '#' )
+      out << line << '\n';
+
+  /* print the header */
+  if (printheader) {
+    out << "# ";
+    out << " groupname ";
+    out << "total_accuracy ";
+    out << "total_recall ";
+    out << "total_precision ";
+    out << "total_Fbeta ";
+    out << "total_NPV ";
+    out << "total_TNR ";
+    for (auto &label : labelset) {
+      out << label << "_accuracy ";
+      out << label << "_recall ";
+      out << label << "_precision ";
+      out << label << "_Fbeta ";
+      out << label << "_NPV ";
+      out << label << "_TNR ";
+    }
+    if (!Fbeta_ci.empty()) {
+      out << "total_recall_lo total_recall_hi ";
+      out << "total_precision_lo total_precision_hi ";
+      out << "total_Fbeta_lo total_Fbeta_hi ";
+    } out << '\n';
+  }
+
+  /* print out the total scores first */
+  out << tag << ' ';
+  out.mean(accuracy) << ' ';
+  out.mean(recall) << ' ';
+  out.mean(precision) << ' ';
+  out.mean(Fbeta) << ' ';
+  out.mean(NPV) << ' ';
+  out.mean(TNR) << ' ';
+
+  for (size_t i=0; i<labelset.size(); i++) {
+    out.fixed_or_zero(accuracy[i]) << ' ';
+    out.fixed_or_zero(recall[i]) << ' ';
+    out.fixed_or_zero(precision[i]) << ' ';
+    out.fixed_or_zero(Fbeta[i]) << ' ';
+    out.fixed_or_zero(NPV[i]) << ' ';
+    out.fixed_or_zero(TNR[i]) << ' ';
+  }
+  if (!Fbeta_ci.empty()) {
+    out << recall_ci.back().first << ' ' << recall_ci.back().second << ' ';
+    out << precision_ci.back().first << ' ' << precision_ci.back().second << ' ';
+    out << Fbeta_ci.back().first << ' ' << Fbeta_ci.back().second << ' ';
+  } out << '\n';
+
+   // TODO also add the EAD
+}
+
+void Group::render(Writer &out, cmdline::parser &c, string tag) {
+  calculate_score(c.get<double>("F-score"));
+
+  /* print out comment attached to this group if any */
+  for( auto &line : lines )
+    if ( line[0] == '#' )
+      out << line << '\n';
+
+  /* print confusion matrix */
+  if (!c.exist("no-confusion")) {
+    size_t tab_size = 0;
+    for (auto &label : labelset)
+      tab_size = tab_size < label.size() ? label.size() : tab_size;
+    tab_size = tab_size < tag.size() ? tag.size() : tab_size;
+    tab_size += 1;
+
+    /* print the header */
+    out << tag;
+    out.pad(tab_size - tag.size());
+    for (auto &label : labelset)
+      out << "  " << label << ' ';
+    out << '\n';
+
+    out.pad(tab_size,'-') << ' ';
+    for (auto &label : labelset)
+      out.pad(label.size()+2,'-') << ' ';
+    out << '\n';
+
+    /* print the row */
+    for (uint64_t i=0; i<labelset.size(); i++) {
+      out << labelset[i];
+      out.pad(tab_size - labelset[i].size());
+
+      for(uint64_t j=0; j<labelset.size(); j++) {
+        char num[24];
+        int len  = snprintf(num, sizeof(num), "%" PRIu64, (*confusion)[i][j]);
+        int pre  = (labelset[j].size() + 2 - len)/2,
+            post = labelset[j].size() + 2 - len - pre;
+        pre = pre < 0 ? 0 : pre;
+        post = post < 0 ? 0 : post;
+
+        out << ' ';
+        if ((*confusion)[i][j] == 0)
+          out.pad(labelset[j].size() + 2);
+        else
+          out.pad(pre).append(num, len).pad(post);
+      }
+      out << '\n';
+    }
+
+    out.pad(tab_size,'-') << ' ';
+    for (auto &label : labelset)
+      out.pad(label.size()+2,'-') << ' ';
+    out << '\n';
+  }
+
+  /* print stats */
+  if (!c.exist("no-score")) {
+    size_t tab_size = 2;
+
+    if (!c.exist("no-confusion"))
+      out << '\n';
+
+    for (auto &label : labelset)
+      tab_size = tab_size < label.size() ? label.size() : tab_size;
+    tab_size = tab_size < tag.size() ? tag.size() : tab_size;
+    tab_size += 1;
+
+    uint64_t TAB_SIZE = 18;
+
+    out << tag;
+    out.pad(tab_size - tag.size()) << ' ';
+    out.centered(TAB_SIZE,"  accuracy  ");
+    out.centered(TAB_SIZE,"  recall  ");
+    out.centered(TAB_SIZE,"  precision  ");
+    out.centered(TAB_SIZE,"  Fbeta  ");
+    out.centered(TAB_SIZE,"   NPV   ");
+    out.centered(TAB_SIZE,"   TNR   ");
+    out << '\n';
+
+    out.pad(tab_size, '-') << ' ' ;
+    out.pad(TAB_SIZE-1, '-') << ' ';
+    out.pad(TAB_SIZE-1, '-') << ' ';
+    out.pad(TAB_SIZE-1, '-') << ' ';
+    out.pad(TAB_SIZE-1, '-') << ' ';
+    out.pad(TAB_SIZE-1, '-');
+    out << '\n';
+
+    for (size_t i=0; i<labelset.size(); i++) {
+      out << labelset[i];
+      out.pad(tab_size - labelset[i].size() + 1);
+      out.centered_or_empty(TAB_SIZE, accuracy[i]);
+      out.centered_or_empty(TAB_SIZE, recall[i]);
+      out.centered_or_empty(TAB_SIZE, precision[i]);
+      out.centered_or_empty(TAB_SIZE, Fbeta[i]);
+      out.centered_or_empty(TAB_SIZE, NPV[i]);
+      out.centered_or_empty(TAB_SIZE, TNR[i]);
+      out << '\n';
+    }
+
+    out.pad(tab_size+1);
+    out.meanstd(TAB_SIZE-1, accuracy) << ' ';
+    out.meanstd(TAB_SIZE-1, recall) << ' ';
+    out.meanstd(TAB_SIZE-1, precision) << ' ';
+    out.meanstd(TAB_SIZE-1, Fbeta) << ' ';
+    out.meanstd(TAB_SIZE-1, NPV) << ' ';
+    out.meanstd(TAB_SIZE-1, TNR) << ' ';
+    out << '\n';
+
+    /* bootstrap intervals of the class scores, last row is the mean */
+    if (!Fbeta_ci.empty()) {
+      string level = std::to_string((int) round(100*c.get<double>("confidence"))) + "%";
+
+      out << '\n';
+      out << tag;
+      out.pad(tab_size - tag.size()) << ' ';
+      out.centered(TAB_SIZE,"  recall " + level + "  ");
+      out.centered(TAB_SIZE,"  precision " + level + "  ");
+      out.centered(TAB_SIZE,"  Fbeta " + level + "  ");
+      out << '\n';
+
+      out.pad(tab_size, '-') << ' ' ;
+      out.pad(TAB_SIZE-1, '-') << ' ';
+      out.pad(TAB_SIZE-1, '-') << ' ';
+      out.pad(TAB_SIZE-1, '-');
+      out << '\n';
+
+      static const string none;
+      for (size_t i=0; i<=labelset.size(); i++) {
+        const string &name = i<labelset.size() ? labelset[i] : none;
+        out << name;
+        out.pad(tab_size - name.size() + 1);
+        out.interval(TAB_SIZE, recall_ci[i]);
+        out.interval(TAB_SIZE, precision_ci[i]);
+        out.interval(TAB_SIZE, Fbeta_ci[i]);
+        out << '\n';
+      }
+    }
+  }
+
+  /* print EAD */
+  if (!c.exist("no-ead")) {
+    if (!c.exist("no-confusion") || !c.exist("no-score"))
+      out << '\n';
+
+    uint64_t ev_total = ead.deletions + ead.ev_fragmented + ead.ev_fragmerged +
+                        ead.ev_merged + ead.correct,
+             re_total = ead.correct + ead.re_merged + ead.re_fragmerged +
+                        ead.re_fragmented + ead.insertions;
+    double total = ev_total + re_total - ead.correct;
+    double LINE_SIZE = 80 - 3*8,
+             d = ead.deletions / total,
+             ef = ead.ev_fragmented / total, efm = ead.ev_fragmerged / total,
+             em = ead.ev_merged / total, c = ead.correct / total,
+             rm = ead.re_merged / total, rfm = ead.re_fragmerged / total,
+             rf = ead.re_fragmented / total, i = ead.insertions / total;
+
+    if (total > 0) {
+      /* column widths of the nine EAD columns */
+      double w[] = { d*LINE_SIZE+4, ef*LINE_SIZE+4, efm*LINE_SIZE+4, em*LINE_SIZE+4,
+                     c*LINE_SIZE+4, rm*LINE_SIZE+4, rfm*LINE_SIZE+4, rf*LINE_SIZE+4,
+                     i*LINE_SIZE+4 };
+      const char *names[] = { "D", "F", "FM", "M", "C", "M", "FM", "F", "I" };
+      double percent[] = { 100*d, 100*ef, 100*efm, 100*em, 100*c, 100*rm, 100*rfm, 100*rf, 100*i };
+      uint64_t counts[] = { ead.deletions, ead.ev_fragmented, ead.ev_fragmerged, ead.ev_merged,
+                            ead.correct, ead.re_merged, ead.re_fragmerged, ead.re_fragmented,
+                            ead.insertions };
+
+      for (int k=0; k<5; k++)
+        out.pad(w[k], '-') << (k<4 ? " " : "\n");
+
+      for (int k=0; k<9; k++)
+        out.centered(w[k], names[k], 4) << (k<8 ? " " : "\n");
+
+      for (int k=0; k<9; k++)
+        out.centered(w[k], percent[k], 4) << (k<8 ? " " : "\n");
+
+      for (int k=0; k<9; k++)
+        out.centered(w[k], counts[k], 4) << (k<8 ? " " : "\n");
+
+      for (int k=0; k<9; k++)
+        out.pad(w[k], k<4 ? ' ' : '-') << (k<8 ? " " : "\n");
+    } else {
+      out << "total is zero\n";
+    }
+  }
+}
+
+void Group::bootstrap(size_t replicates, double beta, double level, unsigned threads, unsigned seed)
+{
+  Fbeta_ci.clear(); recall_ci.clear(); precision_ci.clear();
+  if (confusion == NULL || replicates == 0)
+    return;
+
+  /* flatten the confusion matrix, each replicate redistributes the same
+   * number of frames over its cells, so there is no need to keep the
+   * original lines around */
+  size_t n = labelset.size(), k = n+1;
+  vector<uint64_t> counts(n*n);
+  for (size_t i=0; i<n; i++)
+    for (size_t j=0; j<n; j++)
+      counts[i*n+j] = (*confusion)[i][j];
+  uint64_t total = accumulate(counts.begin(), counts.end(), (uint64_t) 0);
+
+  /* scores are stored per class, replicates are contiguous for each */
+  vector<double> F(k*replicates), R(k*replicates), P(k*replicates);
+
+  parallel_for(replicates, threads, [&](size_t begin, size_t end) {
+    vector<uint64_t> sample(n*n);
+    vector<double> f(k), r(k), p(k);
+
+    for (size_t b=begin; b<end; b++) {
+      seed_seq sseq{seed, (unsigned) b};
+      mt19937_64 rng(sseq);
+
+      resample_counts(counts, total, rng, sample);
+      score_counts(sample.data(), n, beta, f.data(), r.data(), p.data());
+
+      for (size_t i=0; i<k; i++) {
+        F[i*replicates+b] = f[i];
+        R[i*replicates+b] = r[i];
+        P[i*replicates+b] = p[i];
+      }
+    }
+  });
+
+  for (size_t i=0; i<k; i++) {
+    Fbeta_ci.push_back( percentile_interval(&F[i*replicates], replicates, level) );
+    recall_ci.push_back( percentile_interval(&R[i*replicates], replicates, level) );
+    precision_ci.push_back( percentile_interval(&P[i*replicates], replicates, level) );
+  }
+}
+
+string bootstrap_groups(unordered_map<string,Group> &groups, size_t replicates,
+                        double beta, double level, unsigned threads, unsigned seed)
+{
+  /* bring all confusion matrices onto a common labelset */
+  vector<string> labelset;
+  vector<const Group*> members;
+  for (auto &group : groups) {
+    if (group.second.confusion == NULL) continue;
+    for (auto label : group.second.labelset)
+      push_back_if_not_there(label, labelset);
+    members.push_back(&group.second);
+  }
+
+  size_t n = labelset.size(), m = members.size();
+  vector<uint64_t> counts(m*n*n, 0);
+  for (size_t g=0; g<m; g++) {
+    const Group &group = *members[g];
+    vector<size_t> idx;
+    for (auto label : group.labelset)
+      idx.push_back( push_back_if_not_there(label, labelset) );
+
+    for (size_t i=0; i<idx.size(); i++)
+      for (size_t j=0; j<idx.size(); j++)
+        counts[g*n*n + idx[i]*n + idx[j]] = (*group.confusion)[i][j];
+  }
+
+  /* resample whole groups with replacement and score the pooled counts */
+  vector<double> F(replicates), R(replicates), P(replicates);
+
+  parallel_for(replicates, threads, [&](size_t begin, size_t end) {
+    vector<uint64_t> pooled(n*n);
+    vector<double> f(n+1), r(n+1), p(n+1);
+    uniform_int_distribution<size_t> pick(0, m-1);
+
+    for (size_t b=begin; b<end; b++) {
+      seed_seq sseq{seed, (unsigned) b};
+      mt19937_64 rng(sseq);
+
+      fill(pooled.begin(), pooled.end(), 0);
+      for (size_t g=0; g<m; g++) {
+        const uint64_t *src = &counts[pick(rng)*n*n];
+        for (size_t i=0; i<n*n; i++)
+          pooled[i] += src[i];
+      }
+
+      score_counts(pooled.data(), n, beta, f.data(), r.data(), p.data());
+      F[b] = f[n]; R[b] = r[n]; P[b] = p[n];
+    }
+  });
+
+  pair<double,double> f = percentile_interval(F.data(), replicates, level),
+                      r = percentile_interval(R.data(), replicates, level),
+                      p = percentile_interval(P.data(), replicates, level);
+
+  stringstream ss;
+  ss << "# bootstrap over " << m << " groups (" << replicates << " replicates, "
+     << level << " confidence): ";
+  ss << "recall " << r.first << " " << r.second << " ";
+  ss << "precision " << p.first << " " << p.second << " ";
+  ss << "Fbeta " << f.first << " " << f.second << endl;
+  return ss.str();
+}
+
+/* per-class recall, precision and Fbeta of a flat confusion matrix with
+ * predictions in rows and labels in columns. The class mean, with NaNs
+ * counted as zero, is written to the n-th entry. */
+void score_counts(const uint64_t *counts, size_t n, double beta, double *F, double *R, double *P)
+{
+  double b2 = beta*beta;
+  F[n] = R[n] = P[n] = 0;
+
+  for (size_t i=0; i<n; i++) {
+    uint64_t TP = counts[i*n+i], rowsum = 0, colsum = 0;
+    for (size_t j=0; j<n; j++) {
+      rowsum += counts[i*n+j];
+      colsum += counts[j*n+i];
+    }
+
+    R[i] = TP / (double) colsum;
+    P[i] = TP / (double) rowsum;
+    F[i] = (1+b2) * (P[i]*R[i]) / (b2*P[i] + R[i]);
+
+    if (std::isnan(R[i])) R[i] = 0;
+    if (std::isnan(P[i])) P[i] = 0;
+    if (std::isnan(F[i])) F[i] = 0;
+
+    F[n] += F[i]/n; R[n] += R[i]/n; P[n] += P[i]/n;
+  }
+}
+
+/* draw a multinomial sample of size total with cell probabilities given by
+ * counts, done as a chain of conditional binomials (one draw per cell) */
+void resample_counts(const vector<uint64_t> &counts, uint64_t total, mt19937_64 &rng, vector<uint64_t> &out)
+{
+  uint64_t left = total, mass = total;
+
+  for (size_t i=0; i<counts.size(); i++) {
+    out[i] = 0;
+    if (counts[i] != 0 && left != 0) {
+      binomial_distribution<uint64_t> draw(left, counts[i] / (double) mass);
+      out[i] = draw(rng);
+      left  -= out[i];
+    }
+    mass -= counts[i];
+  }
+}
+
+pair<double,double> percentile_interval(double *values, size_t n, double level)
+{
+  double alpha = (1-level)/2;
+  size_t lo = floor(alpha*(n-1)),
+         hi = ceil((1-alpha)*(n-1));
+
+  sort(values, values+n);
+  return make_pair(values[lo], values[hi]);
+}
+
+/* split [0,n) into equal chunks and run func(begin,end) on each in its own thread */
+template< class F>
+void parallel_for(size_t n, unsigned threads, F func)
+{
+  vector<thread> workers;
+  size_t chunk = (n + threads - 1) / threads;
+
+  for (size_t begin=0; begin<n; begin+=chunk)
+    workers.push_back( thread(func, begin, min(n, begin+chunk)) );
+
+  for (auto &worker : workers)
+    worker.join();
+}
+
+Writer& Writer::centered(int tab_size, const char *val, size_t len, int DEFAULT) {
+  if (tab_size < DEFAULT) tab_size = DEFAULT;
+  if (len > (size_t) tab_size) len = tab_size;
+
+  int pre = (tab_size - len) / 2,
+     post =  tab_size - len - pre;
+
+  return pad(pre).append(val, len).pad(post);
+}
+
+Writer& Writer::centered(int tab_size, double value, int DEFAULT) {
+  char tmp[128];
+  int len = snprintf(tmp, sizeof(tmp), "%f", value);
+  return centered(tab_size, tmp, min<size_t>(len, sizeof(tmp)-1), DEFAULT);
+}
+
+Writer& Writer::centered(int tab_size, uint64_t value, int DEFAULT) {
+  char tmp[24];
+  int len = snprintf(tmp, sizeof(tmp), "%" PRIu64, value);
+  return centered(tab_size, tmp, len, DEFAULT);
+}
+
+Writer& Writer::centered_or_empty(int tab_size, double value) {
+  return std::isnan(value) ? centered(tab_size, "") : centered(tab_size, value);
+}
+
+Writer& Writer::interval(int tab_size, pair<double,double> ci) {
+  char tmp[128];
+  int len = snprintf(tmp, sizeof(tmp), "%f-%f", ci.first, ci.second);
+  return centered(tab_size, tmp, min<size_t>(len, sizeof(tmp)-1));
+}
+
+/* mean and standard deviation over a list with NaNs counted as zero */
+Writer& Writer::meanstd(int tab_size, const vector<double> &list) {
+  char tmp[64];
+  int len = 0;
+  size_t n = list.size();
+  double mean = 0, var = 0;
+
+  for (auto val : list)
+    mean += std::isnan(val) ? 0. : val;
+  mean /= n;
+
+  for (auto val : list)
+    var += std::pow(std::abs((std::isnan(val) ? 0. : val) - mean), 2);
+
+  if (n == 1)
+    len = snprintf(tmp, sizeof(tmp), "%f", mean);
+  else if (n > 1)
+    len = snprintf(tmp, sizeof(tmp), "%g/%g", mean, sqrt(var/n));
+
+  return centered(tab_size, tmp, min<size_t>(len, sizeof(tmp)-1));
+}
+
+Writer& Writer::mean(const vector<double> &list) {
+  double mean = 0;
+
+  if (list.size() == 0)
+    return *this;
+
+  for (auto val : list)
+    mean += std::isnan(val) ? 0. : val;
+
+  return fixed(mean / list.size());
+}
+
+template< class T>
+vector<T> diag(Matrix<T> &m) {
+  vector<T> d;
+  for (int i=0; i<m.getNumRows(); i++)
+    d.push_back(m[i][i]);
+  return d;
+}
+
+template< class T>
+T sum(vector<T> m) {
+  T result = m[0];
+  for (int i=1; i<m.size(); i++)
+    result += m[i];
+  return result;
+}
+
+template< class T>
+T sum(Matrix<T> &m) {
+  T result = 0;
+  for (int i=0; i<m.getNumRows(); i++)
+    for (int j=0; j<m.getNumCols(); j++)
+      result += m[i][j];
+  return result;
+}
+
+template< class T>
+Matrix<T>* resize_matrix(Matrix<T> *old, size_t newsize) {
+  Matrix<T> *confusion = new Matrix<T>(newsize, newsize);
+  confusion->setAllValues(0);
+
+  for (T i=0; i<old->getNumRows(); i++)
+    for (T j=0; j<old->getNumRows(); j++)
+      (*confusion)[i][j] = (*old)[i][j];
+
+  delete old;
+  return confusion;
+}
+
+template< class T>
+vector<T>  rowsum(Matrix<T> &m) {
+  vector<T> result;
+  for (int i=0; i<m.getNumRows(); i++) {
+    vector<T> row = m.getRowVector(i);
+    result.push_back( sum(row) );
+  }
+  return result;
+}
+
+template< class T>
+vector<T>  colsum(Matrix<T> &m) {
+  vector<T> result;
+  for (int i=0; i<m.getNumCols(); i++) {
+    vector<T> col = m.getColVector(i);
+    result.push_back( sum(col) );
+  }
+  return result;
+}
+
+template< class T>
+vector<T> abs(vector<T> m) {
+  vector<T> result;
+  for (int i=0; i<m.size(); i++) {
+    T val = m[i];
+    result.push_back( std::abs(val) );
+  }
+  return result;
+}
+
+template< class T>
+vector<T>  pow(vector<T> m, double pow) {
+  vector<T> result;
+  for (int i=0; i<m.size(); i++) {
+    T val = std::pow(m[i], pow);
+    result.push_back( val );
+  }
+  return result;
+}
+
+int push_back_if_not_there(const string &label, vector<string> &labelset)
+{
+ if( std::find(labelset.begin(), labelset.end(), label) == labelset.end() )
+  labelset.push_back(label);
+
+ return std::find(labelset.begin(), labelset.end(), label) - labelset.begin();
+}
+
+template< class T>
+std::vector<T> operator-(const std::vector<T> &a, const std::vector<T> &b)
+{
+  std::vector<T> res(a.size());
+  for(size_t i=0; i<a.size(); ++i)
+    res[i]=a[i]-b[i];
+  return res;
+}
+
+template< class T>
+std::vector<T> operator+(const std::vector<T> &a, const std::vector<T> &b)
+{
+  std::vector<T> res(a.size());
+  for(size_t i=0; i<a.size(); ++i)
+    res[i]=a[i]+b[i];
+  return res;
+}
+
+template< class T> vector<T>  operator-(T a, const std::vector<T> &b)
+{
+  vector<T> res(b.size());
+  for (size_t i=0; i<b.size(); ++i)
+    res[i]=a-b[i];
+  return res;
+}
+
+template< class T> vector<T>  operator-(const std::vector<T> &b, T a)
+{
+  vector<T> res(b.size());
+  for (size_t i=0; i<b.size(); ++i)
+    res[i]=b[i]-a;
+  return res;
+}
+
+template< class T> vector<T>  operator*(T a, const std::vector<T> &b)
+{
+  vector<T> res(b.size());
+  for (size_t i=0; i<b.size(); ++i)
+    res[i]=a*b[i];
+  return res;
+}
+
+template< class T> vector<T>  operator+(T a, const std::vector<T> &b)
+{
+  vector<T> res(b.size());
+  for (size_t i=0; i<b.size(); ++i)
+    res[i]=a+b[i];
+  return res;
+}
+
+#endif
@@ -0,0 +1,341 @@
+#include "cmdline.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <float.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+using namespace std;
+
+/* one parsed input line, data holds the tab-joined samples without label */
+struct Row {
+  string label, data;
+  double energy;
+};
+
+/* Fixed capacity ring of rows. Slots are re-used, so the strings keep their
+ * capacity and no allocation happens once the ring has been filled. */
+class Ring {
+  public:
+  vector<Row> rows;
+  size_t start = 0, count = 0;
+
+  Ring(size_t capacity) : rows(capacity) {}
+
+  size_t size() { return count; }
+  bool full() { return count == rows.size(); }
+
+  /* i-th oldest row */
+  Row &operator[](size_t i) { return rows[(start + i) % rows.size()]; }
+
+  /* slot for a new row, overwrites the oldest one if the ring is full */
+  Row &push() {
+    if (full()) pop(1);
+    return rows[(start + count++) % rows.size()];
+  }
+
+  void pop(size_t n) {
+    n = min(n, count);
+    start = (start + n) % rows.size();
+    count -= n;
+  }
+};
+
+/* Each segmenter gets one row at a time, together with its position in the
+ * stream. Segments are either written as text, separated by empty lines, or
+ * only as the [begin,end) range of row positions when boundaries is set. */
+class Segmenter {
+  public:
+  ostream &out;
+  bool boundaries;
+
+  Segmenter(ostream &o, bool b) : out(o), boundaries(b) {}
+  virtual ~Segmenter() {}
+
+  virtual void push(const Row &row, size_t pos) = 0;
+  virtual void finish(size_t) {}
+
+  protected:
+  void range(size_t begin, size_t end) { out << begin << "\t" << end << "\n"; }
+  void line(const string &label, const string &data) { out << label << "\t" << data << "\n"; }
+};
+
+/* splits whenever the groundtruth label changes or a maximum number of
+ * samples has been reached */
+class GroundTruth : public Segmenter {
+  public:
+  string label;
+  size_t max_size, count = 0, begin = 0;
+  bool first = true;
+
+  GroundTruth(ostream &o, bool b, size_t max) : Segmenter(o,b), max_size(max) {}
+
+  void push(const Row &row, size_t pos) {
+    if (first || label != row.label || (max_size != 0 && count > max_size)) {
+      if (boundaries && !first) range(begin, pos);
+      if (!boundaries) out << "\n";
+      label = row.label;
+      count = 0;
+      begin = pos;
+      first = false;
+    }
+    if (!boundaries) line(row.label, row.data);
+    count++;
+  }
+
+  void finish(size_t pos) {
+    if (boundaries && !first) range(begin, pos);
+  }
+};
+
+/* fixed size windows, which are advanced by hop samples */
+class SlidingWindow : public Segmenter {
+  public:
+  Ring window;
+  size_t hop, head = 0; // stream position of the oldest row in the window
+
+  SlidingWindow(ostream &o, bool b, size_t size, size_t h) : Segmenter(o,b), window(size), hop(h) {}
+
+  void push(const Row &row, size_t) {
+    if (window.full()) {
+      if (boundaries)
+        range(head, head + window.size());
+      else {
+        for (size_t i=0; i<window.size(); i++)
+          line(window[i].label, window[i].data);
+        out << "\n";
+      }
+      window.pop(hop);
+      head += hop;
+    }
+    window.push() = row;
+  }
+};
+
+/* Splits when the signal energy, averaged over an integration window, crosses
+ * a threshold. Samples are written delayed by half the window, but with the
+ * label of the most recent one. The energy is summed up incrementally and
+ * only when it comes closer to the threshold than the accumulated rounding
+ * error, the window is summed up again in its original order. */
+class Energy : public Segmenter {
+  public:
+  Ring window;
+  double threshold, sum = 0, peak = 0;
+  size_t updates = 0, begin = 0, end = 0;
+  bool below = true, printed = false;
+
+  Energy(ostream &o, bool b, size_t size, double t) : Segmenter(o,b), window(size), threshold(t) {}
+
+  void push(const Row &row, size_t pos) {
+    if (window.full()) sum -= window[0].energy;
+    window.push() = row;
+    sum += row.energy;
+    peak = max(peak, fabs(sum));
+    updates++;
+
+    if (!window.full())
+      return;
+
+    if (updates > window.size())
+      resync();
+
+    size_t delayed = pos + 1 - window.size() + window.size()/2;
+    if (!printed) begin = delayed;
+    end = delayed + 1;
+    printed = true;
+
+    if (!boundaries)
+      line(row.label, window[window.size()/2].data);
+
+    if (above() == below) {
+      below = !below;
+      if (boundaries) range(begin, end);
+      else out << "\n";
+      begin = end;
+    }
+  }
+
+  void finish(size_t) {
+    if (boundaries && printed && begin != end) range(begin, end);
+  }
+
+  protected:
+  double exact() {
+    double e = 0;
+    for (size_t i=0; i<window.size(); i++)
+      e += window[i].energy;
+    return e / window.size();
+  }
+
+  void resync() {
+    sum = peak = 0;
+    for (size_t i=0; i<window.size(); i++)
+      sum += window[i].energy;
+    peak = fabs(sum);
+    updates = 0;
+  }
+
+  bool above() {
+    double limit = threshold * window.size(),
+           bound = 8 * (updates + window.size()) * DBL_EPSILON * (peak + fabs(limit));
+    if (!std::isfinite(sum) || fabs(sum - limit) <= bound)
+      return exact() > threshold;
+    return sum > limit;
+  }
+};
+
+Segmenter *segmenter_from_args(string, cmdline::parser&, vector<string>&);
+bool split(const string&, Row&, bool);
+
+int main(int argc, const char *argv[])
+{
+  cmdline::parser c;
+  c.add        ("help",       'h', "print this message");
+  c.add        ("boundaries", 'b', "only print the [begin,end) sample range of each segment");
+  c.footer     ("<segmenter> [input-data]...");
+
+  /* parse common arguments */
+  bool parse_ok = c.parse(argc, argv, false) && !c.exist("help");
+
+  string name = c.rest().size() > 0 ? c.rest()[0] : "list";
+  if (name == "list") {
+    cout << c.usage() << endl;
+    cout << "gt" << endl << "sw" << endl << "nrg" << endl;
+    return 0;
+  }
+
+  vector<string> files;
+  Segmenter *segmenter = segmenter_from_args(name, c, files);
+  bool energy = name == "nrg";
+
+  if (!parse_ok) {
+    cerr << c.usage() << endl << c.error() << endl;
+    return -1;
+  }
+
+  if (files.size() == 0)
+    files.push_back("-");
+
+  ios_base::sync_with_stdio(false);
+
+  Row row;
+  size_t pos = 0; // number of samples read so far
+
+  for (auto &filename : files) {
+    ifstream fin;
+    if (filename != "-") fin.open(filename);
+    istream &in = filename == "-" ? cin : fin;
+
+    if (!in.good()) {
+      cerr << "unable to open input file " << filename << endl;
+      return -1;
+    }
+
+    string line;
+    while (getline(in, line)) {
+      size_t start = line.find_first_not_of(" \t\r\n\v\f");
+      if (start == string::npos)
+        continue;
+
+      /* comments are passed through, followed by an empty line */
+      if (line[start] == '#') {
+        if (!segmenter->boundaries)
+          cout << line << "\n" << (in.eof() ? "" : "\n");
+        continue;
+      }
+
+      if (!split(line, row, energy)) {
+        cerr << "the energy segmenter needs at least three dimensions per sample" << endl;
+        return -1;
+      }
+
+      segmenter->push(row, pos++);
+    }
+  }
+
+  segmenter->finish(pos);
+  cout.flush();
+  return 0;
+}
+
+/* splits a line at whitespace into label and tab-joined data, and computes
+ * the energy of the first three dimensions if requested */
+bool split(const string &line, Row &row, bool energy)
+{
+  const char *ws = " \t\r\n\v\f";
+  double x[3];
+  size_t n = 0, b = line.find_first_not_of(ws), e = line.find_first_of(ws, b);
+
+  row.label.assign(line, b, e - b);
+  row.data.clear();
+
+  while ((b = line.find_first_not_of(ws, e)) != string::npos) {
+    e = line.find_first_of(ws, b);
+    if (n) row.data += '\t';
+    row.data.append(line, b, e - b);
+    if (energy && n < 3) x[n] = strtod(line.c_str() + b, NULL);
+    n++;
+  }
+
+  if (energy && n < 3)
+    return false;
+
+  row.energy = energy ? x[0]*x[0] + x[1]*x[1] + x[2]*x[2] : 0;
+  return true;
+}
+
+Segmenter *segmenter_from_args(string name, cmdline::parser &c, vector<string> &files)
+{
+  cmdline::parser p;
+
+  if ( "sw" == name ) {
+    p.add<int>   ("window-size", 'W', "number of samples in each window", false, 10);
+    p.add<double>("overlap",     'O', "percentage from [0,1] of overlap in each window", false, 0);
+  } else if ( "gt" == name ) {
+    p.add<int>   ("window-size", 'W', "set to non-zero for maximum sample size before split", false, 0);
+  } else if ( "nrg" == name ) {
+    p.add<double>("threshold",   'T', "creates a new segment every time the threshold is crossed", false, 0);
+    p.add<int>   ("window-size", 'W', "size of the integration window", false, 1);
+  } else {
+    cerr << "segmenter not implemented: " << name << endl;
+    exit(-1);
+  }
+
+  if (c.exist("help")) {
+    cerr << c.usage() << endl << name << " options:" << endl << p.str_options();
+    exit(0);
+  }
+
+  if (!p.parse(c.rest())) {
+    cerr << c.usage() << endl << name << " options:" << endl << p.str_options() << endl << p.error() << endl;
+    exit(-1);
+  }
+
+  files = p.rest();
+
+  int size = p.get<int>("window-size");
+  bool boundaries = c.exist("boundaries");
+
+  if (size < 0 || (size == 0 && "gt" != name)) {
+    cerr << "-W|--window-size must be larger than 0" << endl;
+    exit(-1);
+  }
+
+  if ( "gt" == name )
+    return new GroundTruth(cout, boundaries, size);
+
+  if ( "nrg" == name )
+    return new Energy(cout, boundaries, size, p.get<double>("threshold"));
+
+  if (p.get<double>("overlap") < 0 || p.get<double>("overlap") > 1) {
+    cerr << "-O|--overlap must be in the range [0,1]" << endl;
+    exit(-1);
+  }
+
+  /* the window advances at least one sample per step */
+  size_t hop = size * (1 - p.get<double>("overlap"));
+  return new SlidingWindow(cout, boundaries, size, max(hop, (size_t) 1));
+}
@@ -1,5 +1,8 @@
 #include <iostream>
 #include <stdio.h>
+#include <sstream>
+#include <algorithm>
+#include <memory>
 
 #include "cmdline.h"
 #include "dlib_trainers.h"
@@ -7,9 +10,14 @@
 using namespace std;
 using namespace dlib;
 
-trainer_template* trainer_from_args(string name, cmdline::parser &c, string &input_file);
+void trainer_args(string name, cmdline::parser &c, cmdline::parser &p, cmdline::parser &s, string &input_file);
+template <typename S> trainer_template<S>* trainer_from_args(string name, bool verbose, unsigned long reduce, int threads, cmdline::parser &p, cmdline::parser &s);
 void parse_specific_args(string name, cmdline::parser &p, cmdline::parser &s);
-any_trainer<sample_type> process_specific_args(string &trainer_str, string &kernel_str, cmdline::parser &s);
+template <typename S> any_trainer<S> process_specific_args(string &trainer_str, string &kernel_str, unsigned long reduce, cmdline::parser &s);
+void split_fold(const std::vector<int> &fold, int k, std::vector<size_t> &train, std::vector<size_t> &test);
+
+typedef std::vector<std::pair<string, string>> grid_point;
+bool grid_from_args(const string &spec, cmdline::parser &s, std::vector<grid_point> &grid);
 
 //_______________________________________________________________________________________________________
 int main(int argc, const char *argv[])
@@ -31,8 +39,12 @@ int main(int argc, const char *argv[])
   c.add        ("help",    'h', "print this message");
   c.add        ("verbose",    'v', "be verbose");
   c.add<int>   ("cross-validate", 'c', "perform k-fold cross validation", false, 0);
+  c.add<string>("grid",    'g', "cross-validate every combination of the given trainer and kernel options and rank them by accuracy, e.g. gamma=0.1,1,10:lambda=0.01,0.1", false);
+  c.add<int>   ("jobs",    'j', "number of folds and grid points to cross-validate in parallel, which share the threads of the classifier and each hold a copy of their training samples", false, 1);
+  c.add<int>   ("reduce",  'r', "approximate the binary decision functions of rbf, poly and sig kernel trainers by this many basis vectors, and report the change in accuracy", false, 0);
   c.add<string>("output",  'o', "store trained classifier in file", false);
-  c.add<string>("trainset",'n', "split the trainig set, either no, random, or k-fold split, defaults to no split.", false, "-1");
+  c.add<string>("trainset",'n', "split the trainig set, either no, random, or k-fold split (k.0 for all folds), defaults to no split.", false, "-1");
+  c.add<string>("precision",'p', "scalar type of the samples and the stored model", false, "double", cmdline::oneof<string>(PRECISION_TYPE));
   c.footer     ("<classifier> [input-data]...");
 
   /* parse common arguments */
@@ -58,14 +70,24 @@ int main(int argc, const char *argv[])
     return -1;
   }
 
-  trainer_template* trainer = trainer_from_args(classifier_str, c, input_file);
+  cmdline::parser p, s;
+  trainer_args(classifier_str, c, p, s, input_file);
 
-  /* check if we can open the output file */
-  ofstream fout(c.get<string>("output"), ios_base::out | ios_base::binary);
-  ostream &output = c.exist("output") ? fout : cout;
+  std::vector<grid_point> grid;
+  if (c.exist("grid") && c.get<int>("cross-validate") <= 0) {
+    cerr << "a parameter grid (-g) is only searched with cross-validation (-c)" << endl;
+    return -1;
+  }
+  if (c.exist("grid") && !grid_from_args(c.get<string>("grid"), s, grid))
+    return -1;
 
-  if (c.exist("output") && !output.good()) {
-    cerr << c.usage() << endl << "unable to open \"" << c.get<string>("output") << "\" as output" << endl;
+  if (c.get<int>("jobs") < 1) {
+    cerr << "-j|--jobs must be larger than 0" << endl;
+    return -1;
+  }
+
+  if (c.get<int>("reduce") < 0) {
+    cerr << "-r|--reduce must not be negative" << endl;
     return -1;
   }
 
@@ -104,7 +126,7 @@ int main(int argc, const char *argv[])
         return -1;
     }
 
-    if (ratio >= 1 && fraction < 1) {
+    if (ratio >= 1 && fraction < 0) {
       cerr << "either -n must be less than one to select a random split "
         "or given as k.x where k is the number of folds, and x the fold to "
         "select " << endl;
@@ -112,6 +134,24 @@ int main(int argc, const char *argv[])
     }
   }
 
+  // k.0 trains one model per fold, which are stored in separate files
+  bool all_folds = !isfile && ratio >= 1 && fraction == 0;
+
+  if (all_folds && !c.exist("output")) {
+    cerr << "training all folds (-n k.0) needs an output file (-o)" << endl;
+    return -1;
+  }
+
+  /* check if we can open the output file */
+  ofstream fout;
+  if (!all_folds) fout.open(c.get<string>("output"), ios_base::out | ios_base::binary);
+  ostream &output = c.exist("output") ? fout : cout;
+
+  if (c.exist("output") && !all_folds && !output.good()) {
+    cerr << c.usage() << endl << "unable to open \"" << c.get<string>("output") << "\" as output" << endl;
+    return -1;
+  }
+
   /* per default we read from the main inputstream */
   ifstream tif; istream &tin = isfile ? tif : in;
   if (isfile) tif.open(file);
@@ -128,49 +168,20 @@ int main(int argc, const char *argv[])
     ##     ## ######## ##     ## ########      ######  ##     ## ##     ## ##        ######## ########  ######
   */
 
-  v_sample_type train_samples;
-  v_label_type train_labels;
-  std::vector<int> train_indices;
+  sample_store store;
   v_label_type u_labels;
 
-  string line, label;
-
-  int ix = 0;
-  while (getline(tin, line)) {
-    stringstream ss(line);
-
-    if (line.find_first_not_of(" \t") == string::npos) {
-      if (train_samples.size() != 0)
-        break;
-      else
-        continue;
-    }
-
-    if (line[0] == '#')
-      continue;
-
-    ss >> label;
-    std::vector<double> sample;
-    string val;
-    while (ss >> val) // this also handles nan and infs correctly
-      sample.push_back(strtod(val.c_str(), NULL));
-
-    if (sample.size() == 0)
-      continue;
-
-    train_samples.push_back(mat(sample));
-    train_labels.push_back(label);
-    train_indices.push_back(ix);
-    ++ix;
+  if (!store.read(tin)) {
+    cerr << "all samples must have the same number of dimensions" << endl;
+    return -1;
   }
-  u_labels = select_all_distinct_labels(train_labels);
-
-  assert((train_samples.size() == train_labels.size()) && (train_samples.size() == train_indices.size()));
+  u_labels = select_all_distinct_labels(store.labels);
 
-  /* select the trainset according to given cli option */
-  v_sample_type test_samples;
-  v_label_type test_labels;
-  std::vector<int> test_indices;
+  /* select the trainset according to given cli option. Every sample is
+   * assigned to the fold in which it is held out for testing, 0 for none,
+   * and the sets of each fold are then built in a single pass. */
+  std::vector<int> fold(store.size(), 0);
+  std::vector<int> selected_folds(1, 0);
 
   if (isfile || ratio <= 0) {
     // ignore, no split
@@ -178,14 +189,14 @@ int main(int argc, const char *argv[])
     // random stratified split:
     // 1. for each class, create a vector containing their respective indices (strata)
     // 2. randomize each stratum and split them according to the provided ratio
-    // 3. according to the created index strata, move the selected samples to the test vectors
+    // 3. mark the selected indices as held-out
 
     // create strata vector with sample indices
     std::vector<std::vector<int>> train_strata(u_labels.size());
     std::vector<std::vector<int>> test_strata(u_labels.size());
     std::vector<label_type> label_list(u_labels.begin(), u_labels.end());
-    for (size_t i = 0; i < train_labels.size(); ++i)
-      train_strata[distance(label_list.begin(), find(label_list.begin(), label_list.end(), train_labels[i]))].push_back(i);
+    for (size_t i = 0; i < store.size(); ++i)
+      train_strata[distance(label_list.begin(), find(label_list.begin(), label_list.end(), store.labels[i]))].push_back(i);
 
     // randomize index strata
     for (auto &v : train_strata)
@@ -195,49 +206,27 @@ int main(int argc, const char *argv[])
     for (size_t i = 0; i < train_strata.size(); ++i)
       split_array(train_strata[i], test_strata[i], ratio);
 
-    // create an ordered set of the selected indices
-    std::set<int> ordered_idx;
     for (size_t i = 0; i < test_strata.size(); ++i)
       for (auto idx : test_strata[i])
-        ordered_idx.insert(idx);
+        fold[idx] = 1;
 
-    // in reverse order, push samples to test sets and delete them from training sets
-    for (auto rit = ordered_idx.rbegin(); rit != ordered_idx.rend(); ++rit) {
-      test_samples.push_back(train_samples[*rit]);
-      test_labels.push_back(train_labels[*rit]);
-      test_indices.push_back(train_indices[*rit]);
-      train_samples.erase(train_samples.begin() + *rit);
-      train_labels.erase(train_labels.begin() + *rit);
-      train_indices.erase(train_indices.begin() + *rit);
-    }
+    selected_folds[0] = 1;
   } else if (ratio >= 1) {
     // k-fold split
 
-    // create folds vector with indices for each fold
-    // the last fold may have more samples
-    int samplesPerFold = train_samples.size() / integral;
-    std::vector<std::vector<int>> folds(integral);
-    for (int i = 0; i < integral - 1; ++i)
-      for (int j = 0; j < samplesPerFold; ++j)
-        folds[i].push_back(i * samplesPerFold + j);
-    for (size_t i = samplesPerFold * (integral - 1); i < train_samples.size(); ++i)
-      folds[integral - 1].push_back(i);
+    // consecutive folds, the last fold may have more samples
+    size_t samplesPerFold = store.size() / integral;
+    for (size_t i = 0; i < store.size(); ++i)
+      fold[i] = samplesPerFold ? std::min<size_t>(i / samplesPerFold, integral - 1) + 1 : integral;
 
-    // move the selected folds samples to the test sets
-    for (auto rit = folds[fraction-1].rbegin(); rit != folds[fraction-1].rend(); ++rit) {
-      test_samples.push_back(train_samples[*rit]);
-      test_labels.push_back(train_labels[*rit]);
-      test_indices.push_back(train_indices[*rit]);
-      train_samples.erase(train_samples.begin() + *rit);
-      train_labels.erase(train_labels.begin() + *rit);
-      train_indices.erase(train_indices.begin() + *rit);
+    selected_folds.assign(1, fraction);
+    if (all_folds) {
+      selected_folds.clear();
+      for (int k = 1; k <= integral; ++k)
+        selected_folds.push_back(k);
     }
   }
 
-  assert((test_samples.size() == test_labels.size()) && (test_samples.size() == test_indices.size()));
-
-
-
   /*
     ######## ########     ###    #### ##    ## #### ##    ##  ######
        ##    ##     ##   ## ##    ##  ###   ##  ##  ###   ## ##    ##
@@ -248,72 +237,146 @@ int main(int argc, const char *argv[])
        ##    ##     ## ##     ## #### ##    ## #### ##    ##  ######
   */
 
-  output << classifier_str << endl << trainer->getKernel() << endl;
-
-  // cross-validate, or train and serialize
-  if (c.get<int>("cross-validate") > 0) {
-    // randomize and cross-validate samples
-    randomize_samples(train_samples, train_labels);
-    matrix<double> cv_result = trainer->crossValidation(train_samples, train_labels, c.get<int>("cross-validate"));
-    cout << classifier_str << " " << c.get<int>("cross-validate") << "-fold cross-validation:" << endl << cv_result << endl;
-
-    cout << "number of samples: " << train_samples.size() << endl;
-    cout << "number of unique labels: " << u_labels.size() << endl << endl;
-
-    cout << "accuracy: " << trace(cv_result) / sum(cv_result) << endl;
-    cout << "F1-score: " << (2 * trace(cv_result)) / (trace(cv_result) + sum(cv_result)) << endl;
-  }
-  // training the classifiers and serializing them to the output
-  else if (classifier_str == TrainerName::ONE_VS_ONE) {
-    ovo_trained_function_type df = trainer->train(train_samples, train_labels).cast_to<ovo_trained_function_type>();
-    if (trainer->getKernel() == "hist")
-      serialize(ovo_trained_function_type_hist_df(df), output);
-    else if (trainer->getKernel() == "lin")
-      serialize(ovo_trained_function_type_lin_df(df), output);
-    else if (trainer->getKernel() == "lin_no")
-      serialize(ovo_trained_function_type_lin_no_df(df), output);
-    else if (trainer->getKernel() == "rbf")
-      serialize(ovo_trained_function_type_rbf_df(df), output);
-    else if (trainer->getKernel() == "poly")
-      serialize(ovo_trained_function_type_poly_df(df), output);
-    else if (trainer->getKernel() == "sig")
-      serialize(ovo_trained_function_type_sig_df(df), output);
-  }
-  else if (classifier_str == TrainerName::ONE_VS_ALL) {
-    ova_trained_function_type df = trainer->train(train_samples, train_labels).cast_to<ova_trained_function_type>();
-    if (trainer->getKernel() == "hist")
-      serialize(ova_trained_function_type_hist_df(df), output);
-    else if (trainer->getKernel() == "lin")
-      serialize(ova_trained_function_type_lin_df(df), output);
-    else if (trainer->getKernel() == "lin_no")
-      serialize(ova_trained_function_type_lin_no_df(df), output);
-    else if (trainer->getKernel() == "rbf")
-      serialize(ova_trained_function_type_rbf_df(df), output);
-    else if (trainer->getKernel() == "poly")
-      serialize(ova_trained_function_type_poly_df(df), output);
-    else if (trainer->getKernel() == "sig")
-      serialize(ova_trained_function_type_sig_df(df), output);
-  }
-  else if (classifier_str == TrainerName::SVM_MULTICLASS_LINEAR) {
-    svm_ml_trained_function_type df = trainer->train(train_samples, train_labels).cast_to<svm_ml_trained_function_type>();
-    serialize(df, output);
-  }
-
-
-  if (!c.exist("output"))
-    cout << endl; // mark the end of the classifier if piping
-  else
-    fout.close();
-
-  if (test_samples.size() > 0) {
-    for (size_t i = 0; i < test_samples.size(); ++i) {
-      cout << test_labels[i];
-      for (int j = 0; j < test_samples[i].size(); ++j)
-        cout << "\t" << test_samples[i](j);
-      cout << endl;
-    }
-    cout << endl;
-  }
+  // folds cross-validated in parallel split the classifier's threads between them, instead of each of
+  // them starting all of its threads
+  int threads = p.get<int>("threads");
+  if (c.get<int>("cross-validate") > 0)
+    threads = max(1, threads / c.get<int>("jobs"));
+
+  // the trainer is instantiated for the sample type matching the precision and number of dimensions
+  return dispatch_sample_type(c.get<string>("precision"), store.dims, [&](auto tag) {
+    typedef typename decltype(tag)::type S;
+    SAMPLE_TRAITS(S)
+
+    unique_ptr<trainer_template<S>> trainer(trainer_from_args<S>(classifier_str, c.exist("verbose"), c.get<int>("reduce"), threads, p, s));
+
+    // one trainer per point of the parameter grid, the specific options are overwritten with its values
+    std::vector<unique_ptr<trainer_template<S>>> grid_owner;
+    std::vector<trainer_template<S>*> grid_trainers;
+    for (auto &point : grid) {
+      for (auto &param : point)
+        s.set_option(param.first, param.second);
+      grid_owner.emplace_back(trainer_from_args<S>(classifier_str, c.exist("verbose"), c.get<int>("reduce"), threads, p, s));
+      grid_trainers.push_back(grid_owner.back().get());
+    }
+
+    for (int k : selected_folds) {
+      v_sample_type samples;
+      v_label_type labels;
+      std::vector<size_t> train_idx, test_idx;
+
+      // only the training samples are copied into matrices, held-out ones are written from the store
+      split_fold(fold, k, train_idx, test_idx);
+      store.select(train_idx, samples, labels);
+
+      ofstream fout_fold, fout_test;
+      if (all_folds) {
+        fout_fold.open(c.get<string>("output") + "." + to_string(k), ios_base::out | ios_base::binary);
+        fout_test.open(c.get<string>("output") + "." + to_string(k) + ".test");
+
+        if (!fout_fold.good() || !fout_test.good()) {
+          cerr << "unable to open \"" << c.get<string>("output") << "." << k << "\" as output" << endl;
+          return -1;
+        }
+      }
+
+      ostream &model = all_folds ? fout_fold : output;
+      ostream &tests = all_folds ? fout_test : cout;
+
+      // cross-validate, or train and serialize
+      if (c.get<int>("cross-validate") > 0 && grid.size() > 0) {
+        // randomize and cross-validate all grid points, and print them ranked by accuracy
+        randomize_samples(samples, labels);
+        std::vector<matrix<double>> cv_results = cross_validate(grid_trainers, samples, labels, c.get<int>("cross-validate"), c.get<int>("jobs"));
+
+        std::vector<size_t> rank(grid.size());
+        for (size_t i = 0; i < rank.size(); ++i)
+          rank[i] = i;
+        std::stable_sort(rank.begin(), rank.end(), [&](size_t a, size_t b) {
+          return trace(cv_results[a]) / sum(cv_results[a]) > trace(cv_results[b]) / sum(cv_results[b]);
+        });
+
+        cout << "rank\taccuracy\tF1-score";
+        for (auto &param : grid[0])
+          cout << "\t" << param.first;
+        cout << endl;
+
+        for (size_t i = 0; i < rank.size(); ++i) {
+          const matrix<double> &cv_result = cv_results[rank[i]];
+          cout << i + 1 << "\t" << trace(cv_result) / sum(cv_result) << "\t" << (2 * trace(cv_result)) / (trace(cv_result) + sum(cv_result));
+          for (auto &param : grid[rank[i]])
+            cout << "\t" << param.second;
+          cout << endl;
+        }
+      }
+      else if (c.get<int>("cross-validate") > 0) {
+        // randomize and cross-validate samples
+        randomize_samples(samples, labels);
+        matrix<double> cv_result = cross_validate(std::vector<trainer_template<S>*>(1, trainer.get()), samples, labels, c.get<int>("cross-validate"), c.get<int>("jobs"))[0];
+        cout << classifier_str << " " << c.get<int>("cross-validate") << "-fold cross-validation:" << endl << cv_result << endl;
+
+        cout << "number of samples: " << samples.size() << endl;
+        cout << "number of unique labels: " << u_labels.size() << endl << endl;
+
+        cout << "accuracy: " << trace(cv_result) / sum(cv_result) << endl;
+        cout << "F1-score: " << (2 * trace(cv_result)) / (trace(cv_result) + sum(cv_result)) << endl;
+      }
+      // training the classifiers and serializing them to the output
+      else {
+        a_df trained = trainer->train(samples, labels);
+
+        // compare the reduced to the original model, on the held-out samples if there are any
+        if (c.get<int>("reduce") > 0) {
+          v_sample_type eval_samples;
+          v_label_type eval_labels;
+          if (test_idx.size() > 0)
+            store.select(test_idx, eval_samples, eval_labels);
+          const v_sample_type &e_samples = test_idx.size() > 0 ? eval_samples : samples;
+          const v_label_type &e_labels = test_idx.size() > 0 ? eval_labels : labels;
+
+          unique_ptr<trainer_template<S>> unreduced(trainer_from_args<S>(classifier_str, false, 0, threads, p, s));
+          a_df original = unreduced->train(samples, labels);
+          matrix<double> reduced_result = test_multiclass_decision_function(trained, e_samples, e_labels),
+                         original_result = test_multiclass_decision_function(original, e_samples, e_labels);
+          double reduced_accuracy = trace(reduced_result) / sum(reduced_result),
+                 original_accuracy = trace(original_result) / sum(original_result);
+
+          cerr << "accuracy with at most " << c.get<int>("reduce") << " basis vectors: " << reduced_accuracy
+               << " (original: " << original_accuracy << ", delta: " << reduced_accuracy - original_accuracy << ")" << endl;
+        }
+
+        // the header describes the model, so that predict-dlib can pick the deserializer from it
+        model_header header;
+        header.trainer = TrainerName::_from_string_nocase(classifier_str.c_str());
+        header.kernel = kernelFromString(trainer->getKernel());
+        header.dims = store.dims;
+        header.classes = select_all_distinct_labels(labels).size();
+
+        if (!model_format<S>::write(model, header, trained)) {
+          cerr << "unable to store " << classifier_str << " with kernel " << trainer->getKernel() << endl;
+          return -1;
+        }
+      }
+
+
+      if (!c.exist("output"))
+        cout << endl; // mark the end of the classifier if piping
+      else if (!all_folds)
+        fout.close();
+
+      if (test_idx.size() > 0) {
+        for (size_t i : test_idx) {
+          tests << store.labels[i];
+          for (long j = 0; j < store.dims; ++j)
+            tests << "\t" << store.row(i)[j];
+          tests << endl;
+        }
+        tests << endl;
+      }
+    }
+
+    return 0;
+  });
 }
 
 
@@ -328,13 +391,30 @@ int main(int argc, const char *argv[])
     ##     ## ######## ######## ##        ######## ##     ##
 */
 
-// toplevel trainer argument parsing. returns a new object from dlib_trainers.h, according to cli options.
+// indices of the training and held-out samples of fold k, in a single pass. training indices are in
+// input order, held-out indices in reverse order.
 //_______________________________________________________________________________________________________
-trainer_template* trainer_from_args(string name, cmdline::parser &c, string &input_file)
+void split_fold(const std::vector<int> &fold, int k, std::vector<size_t> &train, std::vector<size_t> &test)
+{
+  train.clear();
+  test.clear();
+
+  for (size_t i = fold.size(); i-- > 0; )
+    if (k != 0 && fold[i] == k)
+      test.push_back(i);
+    else
+      train.push_back(i);
+
+  std::reverse(train.begin(), train.end());
+}
+
+
+
+
+// toplevel trainer argument parsing. fills the classifier (p) and specific (s) parsers, according to cli options.
+//_______________________________________________________________________________________________________
+void trainer_args(string name, cmdline::parser &c, cmdline::parser &p, cmdline::parser &s, string &input_file)
 {
-  trainer_template* trainer;
-  cmdline::parser p;
-  cmdline::parser s;
 
   std::vector<string> binary(classifierGetType(TrainerType::BINARY));
   std::vector<string> regression(classifierGetType(TrainerType::REGRESSION));
@@ -380,26 +460,38 @@ trainer_template* trainer_from_args(string name, cmdline::parser &c, string &inp
     exit(0);
   }
 
+  if (s.rest().size() > 0)
+    input_file = s.rest()[0];
+}
+
+
+
+
+// returns a new object from dlib_trainers.h for samples of type S, according to the parsed trainer_args().
+// the multiclass trainer runs its binary trainers on the given number of threads.
+//_______________________________________________________________________________________________________
+template <typename S>
+trainer_template<S>* trainer_from_args(string name, bool verbose, unsigned long reduce, int threads, cmdline::parser &p, cmdline::parser &s)
+{
+  trainer_template<S>* trainer;
+
   string kernel_str = p.get<string>("kernel");
   string trainer_str = p.get<string>("trainer");
-  any_trainer<sample_type> subtrainer = process_specific_args(trainer_str, kernel_str, s);
+  any_trainer<S> subtrainer = process_specific_args<S>(trainer_str, kernel_str, reduce, s);
 
   // create trainer
   if (name == TrainerName::ONE_VS_ONE)
-    trainer = new ovo_trainer(c.exist("verbose"), p.get<int>("threads"), kernel_str, subtrainer);
+    trainer = new ovo_trainer<S>(verbose, threads, kernel_str, subtrainer);
   else if (name == TrainerName::ONE_VS_ALL)
-    trainer = new ova_trainer(c.exist("verbose"), p.get<int>("threads"), kernel_str, subtrainer);
+    trainer = new ova_trainer<S>(verbose, threads, kernel_str, subtrainer);
   else if (name == TrainerName::SVM_MULTICLASS_LINEAR)
-    trainer = new svm_ml_trainer(c.exist("verbose"), p.get<int>("threads"), p.exist("nonneg"), p.get<double>("epsilon"), p.get<int>("iterations"), p.get<double>("regularization"));
+    trainer = new svm_ml_trainer<S>(verbose, threads, p.exist("nonneg"), p.get<double>("epsilon"), p.get<int>("iterations"), p.get<double>("regularization"));
 
   else {
     cout << "trainer not implemented yet :(" << endl;
     exit(-1);
   }
 
-  if (s.rest().size() > 0)
-    input_file = s.rest()[0];
-
   return trainer;
 }
 
@@ -536,10 +628,20 @@ void parse_specific_args(string name, cmdline::parser &p, cmdline::parser &s)
 
 
 // process the arguments given in parse_specific_args(). returns an any_trainer type that is used in the ovo/ova_trainer class.
+// kernel trainers are wrapped to reduce their decision functions to the given number of basis vectors, if not 0.
+// reduced2 optimizes the basis vectors along the kernel derivative, which dlib does not define for the hist
+// kernel. lin decision functions are a single weight vector anyway, the linear trainers learn that directly.
 //_______________________________________________________________________________________________________
-any_trainer<sample_type> process_specific_args(string &trainer_str, string &kernel_str, cmdline::parser &s) {
+template <typename S>
+any_trainer<S> process_specific_args(string &trainer_str, string &kernel_str, unsigned long reduce, cmdline::parser &s) {
+  SAMPLE_TRAITS(S)
   any_trainer<sample_type> trainer;
 
+  if (reduce > 0 && (kernel_str == "hist" || kernel_str == "lin")) {
+    cerr << "-r|--reduce needs a rbf, poly or sig kernel" << endl;
+    exit(-1);
+  }
+
   // RELEVANCE VECTOR MACHINE
   if (trainer_str == TrainerName::RVM) {
     if (kernel_str == "hist") {
@@ -561,21 +663,21 @@ any_trainer<sample_type> process_specific_args(string &trainer_str, string &kern
       tmp.set_epsilon(s.get<double>("epsilon"));
       tmp.set_max_iterations(s.get<int>("max-iter"));
       tmp.set_kernel(offset_kernel<rbf_kernel>(rbf_kernel(s.get<double>("gamma")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
     else if (kernel_str == "poly") {
       rvm_trainer<offset_kernel<poly_kernel>> tmp;
       tmp.set_epsilon(s.get<double>("epsilon"));
       tmp.set_max_iterations(s.get<int>("max-iter"));
       tmp.set_kernel(offset_kernel<poly_kernel>(poly_kernel(s.get<double>("gamma"), s.get<double>("coef"), s.get<double>("degree")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
     else if (kernel_str == "sig") {
       rvm_trainer<offset_kernel<sig_kernel>> tmp;
       tmp.set_epsilon(s.get<double>("epsilon"));
       tmp.set_max_iterations(s.get<int>("max-iter"));
       tmp.set_kernel(offset_kernel<sig_kernel>(sig_kernel(s.get<double>("gamma"), s.get<double>("coef")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
   }
 
@@ -606,7 +708,7 @@ any_trainer<sample_type> process_specific_args(string &trainer_str, string &kern
       tmp.set_cache_size(s.get<int>("cache"));
       tmp.set_epsilon(s.get<double>("epsilon"));
       tmp.set_kernel(offset_kernel<rbf_kernel>(rbf_kernel(s.get<double>("gamma")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
     else if (kernel_str == "poly") {
       svm_c_trainer<offset_kernel<poly_kernel>> tmp;
@@ -615,7 +717,7 @@ any_trainer<sample_type> process_specific_args(string &trainer_str, string &kern
       tmp.set_cache_size(s.get<int>("cache"));
       tmp.set_epsilon(s.get<double>("epsilon"));
       tmp.set_kernel(offset_kernel<poly_kernel>(poly_kernel(s.get<double>("gamma"), s.get<double>("coef"), s.get<double>("degree")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
     else if (kernel_str == "sig") {
       svm_c_trainer<offset_kernel<sig_kernel>> tmp;
@@ -624,7 +726,7 @@ any_trainer<sample_type> process_specific_args(string &trainer_str, string &kern
       tmp.set_cache_size(s.get<int>("cache"));
       tmp.set_epsilon(s.get<double>("epsilon"));
       tmp.set_kernel(offset_kernel<sig_kernel>(sig_kernel(s.get<double>("gamma"), s.get<double>("coef")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
   }
 
@@ -687,7 +789,7 @@ any_trainer<sample_type> process_specific_args(string &trainer_str, string &kern
       tmp.set_initial_basis_size(s.get<int>("basis-init"));
       tmp.set_basis_size_increment(s.get<int>("basis-inc"));
       tmp.set_kernel(offset_kernel<rbf_kernel>(rbf_kernel(s.get<double>("gamma")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
     else if (kernel_str == "poly") {
       svm_c_ekm_trainer<offset_kernel<poly_kernel>> tmp;
@@ -699,7 +801,7 @@ any_trainer<sample_type> process_specific_args(string &trainer_str, string &kern
       tmp.set_initial_basis_size(s.get<int>("basis-init"));
       tmp.set_basis_size_increment(s.get<int>("basis-inc"));
       tmp.set_kernel(offset_kernel<poly_kernel>(poly_kernel(s.get<double>("gamma"), s.get<double>("coef"), s.get<double>("degree")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
     else if (kernel_str == "sig") {
       svm_c_ekm_trainer<offset_kernel<sig_kernel>> tmp;
@@ -711,7 +813,7 @@ any_trainer<sample_type> process_specific_args(string &trainer_str, string &kern
       tmp.set_initial_basis_size(s.get<int>("basis-init"));
       tmp.set_basis_size_increment(s.get<int>("basis-inc"));
       tmp.set_kernel(offset_kernel<sig_kernel>(sig_kernel(s.get<double>("gamma"), s.get<double>("coef")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
   }
 
@@ -739,7 +841,7 @@ any_trainer<sample_type> process_specific_args(string &trainer_str, string &kern
       tmp.set_cache_size(s.get<int>("cache"));
       tmp.set_epsilon(s.get<double>("epsilon"));
       tmp.set_kernel(offset_kernel<rbf_kernel>(rbf_kernel(s.get<double>("gamma")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
     else if (kernel_str == "poly") {
       svm_nu_trainer<offset_kernel<poly_kernel>> tmp;
@@ -747,7 +849,7 @@ any_trainer<sample_type> process_specific_args(string &trainer_str, string &kern
       tmp.set_cache_size(s.get<int>("cache"));
       tmp.set_epsilon(s.get<double>("epsilon"));
       tmp.set_kernel(offset_kernel<poly_kernel>(poly_kernel(s.get<double>("gamma"), s.get<double>("coef"), s.get<double>("degree")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
     else if (kernel_str == "sig") {
       svm_nu_trainer<offset_kernel<sig_kernel>> tmp;
@@ -755,7 +857,7 @@ any_trainer<sample_type> process_specific_args(string &trainer_str, string &kern
       tmp.set_cache_size(s.get<int>("cache"));
       tmp.set_epsilon(s.get<double>("epsilon"));
       tmp.set_kernel(offset_kernel<sig_kernel>(sig_kernel(s.get<double>("gamma"), s.get<double>("coef")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
   }
 
@@ -786,7 +888,7 @@ any_trainer<sample_type> process_specific_args(string &trainer_str, string &kern
       if (s.exist("regression")) tmp.use_regression_loss_for_loo_cv();
       else tmp.use_classification_loss_for_loo_cv();
       tmp.set_kernel(offset_kernel<rbf_kernel>(rbf_kernel(s.get<double>("gamma")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
     else if (kernel_str == "poly") {
       krr_trainer<offset_kernel<poly_kernel>> tmp;
@@ -795,7 +897,7 @@ any_trainer<sample_type> process_specific_args(string &trainer_str, string &kern
       if (s.exist("regression")) tmp.use_regression_loss_for_loo_cv();
       else tmp.use_classification_loss_for_loo_cv();
       tmp.set_kernel(offset_kernel<poly_kernel>(poly_kernel(s.get<double>("gamma"), s.get<double>("coef"), s.get<double>("degree")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
     else if (kernel_str == "sig") {
       krr_trainer<offset_kernel<sig_kernel>> tmp;
@@ -804,7 +906,7 @@ any_trainer<sample_type> process_specific_args(string &trainer_str, string &kern
       if (s.exist("regression")) tmp.use_regression_loss_for_loo_cv();
       else tmp.use_classification_loss_for_loo_cv();
       tmp.set_kernel(offset_kernel<sig_kernel>(sig_kernel(s.get<double>("gamma"), s.get<double>("coef")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
   }
 
@@ -817,7 +919,7 @@ any_trainer<sample_type> process_specific_args(string &trainer_str, string &kern
     rbf_network_trainer<offset_kernel<rbf_kernel>> tmp;
     tmp.set_num_centers(s.get<int>("max-centers"));
     tmp.set_kernel(offset_kernel<rbf_kernel>(rbf_kernel(s.get<double>("gamma")), s.get<double>("offset")));
-    trainer = tmp;
+    trainer = reducible(tmp, reduce);
   }
 
   // LINEAR RIDGE REGRESSION
@@ -848,19 +950,19 @@ any_trainer<sample_type> process_specific_args(string &trainer_str, string &kern
       rvm_regression_trainer<offset_kernel<rbf_kernel>> tmp;
       tmp.set_epsilon(s.get<double>("epsilon"));
       tmp.set_kernel(offset_kernel<rbf_kernel>(rbf_kernel(s.get<double>("gamma")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
     else if (kernel_str == "poly") {
       rvm_regression_trainer<offset_kernel<poly_kernel>> tmp;
       tmp.set_epsilon(s.get<double>("epsilon"));
       tmp.set_kernel(offset_kernel<poly_kernel>(poly_kernel(s.get<double>("gamma"), s.get<double>("coef"), s.get<double>("degree")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
     else if (kernel_str == "sig") {
       rvm_regression_trainer<offset_kernel<sig_kernel>> tmp;
       tmp.set_epsilon(s.get<double>("epsilon"));
       tmp.set_kernel(offset_kernel<sig_kernel>(sig_kernel(s.get<double>("gamma"), s.get<double>("coef")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
   }
 
@@ -891,7 +993,7 @@ any_trainer<sample_type> process_specific_args(string &trainer_str, string &kern
       tmp.set_epsilon_insensitivity(s.get<double>("insensitivity"));
       tmp.set_c(s.get<double>("regularization"));
       tmp.set_kernel(offset_kernel<rbf_kernel>(rbf_kernel(s.get<double>("gamma")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
     else if (kernel_str == "poly") {
       svr_trainer<offset_kernel<poly_kernel>> tmp;
@@ -900,7 +1002,7 @@ any_trainer<sample_type> process_specific_args(string &trainer_str, string &kern
       tmp.set_epsilon_insensitivity(s.get<double>("insensitivity"));
       tmp.set_c(s.get<double>("regularization"));
       tmp.set_kernel(offset_kernel<poly_kernel>(poly_kernel(s.get<double>("gamma"), s.get<double>("coef"), s.get<double>("degree")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
     else if (kernel_str == "sig") {
       svr_trainer<offset_kernel<sig_kernel>> tmp;
@@ -909,7 +1011,7 @@ any_trainer<sample_type> process_specific_args(string &trainer_str, string &kern
       tmp.set_epsilon_insensitivity(s.get<double>("insensitivity"));
       tmp.set_c(s.get<double>("regularization"));
       tmp.set_kernel(offset_kernel<sig_kernel>(sig_kernel(s.get<double>("gamma"), s.get<double>("coef")), s.get<double>("offset")));
-      trainer = tmp;
+      trainer = reducible(tmp, reduce);
     }
   }
 
@@ -927,3 +1029,51 @@ any_trainer<sample_type> process_specific_args(string &trainer_str, string &kern
 
   return trainer;
 }
+
+
+
+
+// parses a parameter grid like gamma=0.1,1,10:lambda=0.01,0.1 into all combinations of the given values.
+// every parameter must be one of the specific trainer and kernel options in s, and every value valid for it.
+//_______________________________________________________________________________________________________
+bool grid_from_args(const string &spec, cmdline::parser &s, std::vector<grid_point> &grid)
+{
+  grid.assign(1, grid_point());
+
+  stringstream params(spec);
+  string param;
+  while (getline(params, param, ':')) {
+    size_t eq = param.find('=');
+    string name = param.substr(0, eq);
+
+    if (eq == string::npos || !s.has(name)) {
+      cerr << "unknown grid parameter: " << name << endl;
+      return false;
+    }
+
+    std::vector<grid_point> combinations;
+    stringstream values(param.substr(eq + 1));
+    string value;
+    while (getline(values, value, ',')) {
+      s.set_option(name, value);
+      if (s.error() != "") {
+        cerr << "invalid grid value: " << name << "=" << value << endl;
+        return false;
+      }
+
+      for (grid_point point : grid) {
+        point.push_back(make_pair(name, value));
+        combinations.push_back(point);
+      }
+    }
+
+    if (combinations.size() == 0) {
+      cerr << "no values for grid parameter: " << name << endl;
+      return false;
+    }
+
+    grid.swap(combinations);
+  }
+
+  return true;
+}
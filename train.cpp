@@ -7,14 +7,14 @@
 using namespace GRT;
 using namespace std;
 
-Classifier *apply_cmdline_args(string,cmdline::parser&,int,string&);
+Classifier *apply_cmdline_args(string,cmdline::parser&,int,vector<string>&);
 string list_classifiers();
 InfoLog info;
 
 int main(int argc, const char *argv[])
 {
   Classifier *classifier = NULL;
-  string input_file = "-";
+  vector<string> input_files;
   cmdline::parser c;
 
   c.add<int>   ("verbose", 'v', "verbosity level: 0-4", false, 1);
@@ -36,7 +36,7 @@ int main(int argc, const char *argv[])
   }
 
   /* add the classifier specific arguments */
-  classifier = apply_cmdline_args(str_classifier,c,1,input_file);
+  classifier = apply_cmdline_args(str_classifier,c,1,input_files);
 
   if (!parse_ok) {
     cerr << c.usage() << endl << c.error() << endl;
@@ -57,14 +57,9 @@ int main(int argc, const char *argv[])
     return -1;
   }
 
-  /* do we read from a file or stdin? */
-  ifstream fin; fin.open(input_file);
-  istream &in = input_file=="-" ? cin : fin;
-
-  if (!in.good()) {
-    cerr << "unable to open input file " << input_file << endl;
-    return -1;
-  }
+  /* do we read from files or stdin? */
+  if (input_files.size() == 0)
+    input_files.push_back("-");
 
   /* now start to read input samples */
   CsvIOSample io( classifier->getTimeseriesCompatible() ? "timeseries" : "classification" );
@@ -104,45 +99,65 @@ int main(int argc, const char *argv[])
     }
   }
 
-  /* per default we read from the main inputstream */
-  ifstream tif; istream &tin = isfile ? tif : in;
-  if (isfile) tif.open(file);
+  /* per default we read from the main input files */
+  vector<string> training_files = input_files;
+  if (isfile) training_files = vector<string>(1, file);
 
-  /* now read the input file completely */
-  while ( tin >> io ) {
-    bool ok=false; csvio_dispatch(io, ok=dataset.add, io.labelset);
-
-    if (!ok) {
-      cerr << "error at line " << io.linenum << endl;
-      exit(-1);
-    }
+  /* the size of the input files is a hint for the number of samples */
+  size_t input_size = 0;
+  for (auto &filename : training_files) {
+    struct stat st;
+    if (filename != "-" && stat(filename.c_str(), &st) == 0)
+      input_size += st.st_size;
   }
+  dataset.reserve(input_size);
+
+  /* now read the input files completely */
+  bool read_ok = csvio_files(training_files, io, [&](CsvIOSample &io, const string &filename) {
+    bool ok=false; csvio_dispatch(io, ok=dataset.add);
+
+    if (!ok)
+      cerr << "error at line " << io.linenum << (training_files.size() > 1 ? " of " + filename : "") << endl;
+    return ok;
+  });
+
+  if (!read_ok)
+    exit(-1);
+
+  dataset.finish(io.labelset);
 
   /* empty input? */
   if (dataset.size() == 0)
     return 0;
 
+  info << dataset.getStatsAsString() << endl;
+
   /* generate training sets if any are required, which is either a timeseries
-   * or classification data */
-  TimeSeriesClassificationData t_test, t_training;
-  ClassificationData           c_test, c_training;
+   * or classification data. Without a split or after a random split, which
+   * removes the test samples from the dataset, the training set is the
+   * collected dataset itself. k-folds are copied out and the dataset is
+   * released afterwards, so the samples are kept only once. */
+  TimeSeriesClassificationData t_test, *t_training = &dataset.t_data;
+  ClassificationData           c_test, *c_training = &dataset.c_data;
+  unique_ptr<TimeSeriesClassificationData> t_fold;
+  unique_ptr<ClassificationData>           c_fold;
 
   /* There is a case for polymorphism in GRT here */
   switch(io.type) {
   case TIMESERIES:
     if (isfile || ratio <= 0) // no split or file
-      t_training = dataset.t_data;
-    else if (ratio < 1) {     // random split
-      t_test     = dataset.t_data.partition( ratio*100, true );
-      t_training = dataset.t_data;
-    }
+      ;
+    else if (ratio < 1)       // random split
+      t_test = dataset.t_data.partition( ratio*100, true );
     else if (ratio >= 1) {    // k-fold
       if (!dataset.t_data.splitDataIntoKFolds( integral, false, false )) {
         cerr << "unable to split data" << endl;
         return -1;
       }
-      t_test     = dataset.t_data.getTestFoldData( fraction );
-      t_training = dataset.t_data.getTrainingFoldData( fraction );
+      t_test = dataset.t_data.getTestFoldData( fraction );
+      t_fold.reset(new TimeSeriesClassificationData(dataset.t_data.getTrainingFoldData( fraction )));
+      t_training = t_fold.get();
+      dataset.t_data.clear();
     }
     else {
       cerr << "unknown train set specification" << endl;
@@ -151,18 +166,18 @@ int main(int argc, const char *argv[])
     break;
   case CLASSIFICATION:
     if (isfile || ratio <= 0) // no split or file
-      c_training = dataset.c_data;
-    else if (ratio < 1)  { // random split
-      c_test     = dataset.c_data.partition( ratio*100, true );
-      c_training = dataset.c_data;
-    }
+      ;
+    else if (ratio < 1)    // random split
+      c_test = dataset.c_data.partition( ratio*100, true );
     else if (ratio >= 1) { // k-fold
       if (!dataset.c_data.splitDataIntoKFolds( integral, false, false )) {
         cerr << "unable to split data" << endl;
         return -1;
       }
-      c_test     = dataset.c_data.getTestFoldData( fraction );
-      c_training = dataset.c_data.getTrainingFoldData( fraction );
+      c_test = dataset.c_data.getTestFoldData( fraction );
+      c_fold.reset(new ClassificationData(dataset.c_data.getTrainingFoldData( fraction )));
+      c_training = c_fold.get();
+      dataset.c_data.clear();
     }
     else {
       cerr << "unknown train set specification" << endl;
@@ -175,16 +190,16 @@ int main(int argc, const char *argv[])
     return -1;
   }
 
-  info << dataset.getStatsAsString() << endl;
-
-  /* train and save classifier */
+  /* train and save classifier, train() takes the data by value and only
+   * passes it on to train_(), which is called directly to save that copy.
+   * The training data is not used after this point. */
   bool ok = false;
   switch(io.type) {
   case TIMESERIES:
-    ok = classifier->train(t_training);
+    ok = classifier->train_(*t_training);
     break;
   case CLASSIFICATION:
-    ok = classifier->train(c_training);
+    ok = classifier->train_(*c_training);
     break;
   }
 
@@ -211,9 +226,20 @@ int main(int argc, const char *argv[])
   // The classifier is trained, we now pass-through data, which is different
   // depending on the mode that has been selected.
   if (isfile) {
-    string line;
-    while (getline(in, line))
-      cout << line << endl;
+    for (auto &filename : input_files) {
+      ifstream fin;
+      if (filename != "-") fin.open(filename);
+      istream &in = filename == "-" ? cin : fin;
+
+      if (!in.good()) {
+        cerr << "unable to open input file " << filename << endl;
+        return -1;
+      }
+
+      string line;
+      while (getline(in, line))
+        cout << line << endl;
+    }
   } else if (ratio > 0) { // random split
     bool first = true;
 
@@ -282,7 +308,7 @@ string list_classifiers() {
 
 #define checkedarg(func, type, name) if(!func(p.get<type>(name))) { cerr << "invalid value for" << name << " " << p.get<type>(name) << endl; return NULL; }
 
-Classifier *apply_cmdline_args(string name,cmdline::parser& c,int num_dimensions,string &input_file)
+Classifier *apply_cmdline_args(string name,cmdline::parser& c,int num_dimensions,vector<string> &input_files)
 {
   cmdline::parser p;
   Classifier *o = NULL;
@@ -556,8 +582,7 @@ Classifier *apply_cmdline_args(string name,cmdline::parser& c,int num_dimensions
   if (o != NULL)
     o->setNumInputDimensions(num_dimensions);
 
-  if (p.rest().size() > 0)
-    input_file = p.rest()[0];
+  input_files = p.rest();
 
   return o;
 }